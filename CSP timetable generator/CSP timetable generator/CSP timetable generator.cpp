@@ -1,758 +1,1365 @@
 ﻿#include "httplib.h"
+#include "solver.h"
 #include <nlohmann/json.hpp>
 #include <iostream>
 #include <vector>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
+#include <map>
 #include <algorithm>
 #include <iomanip>
 #include <chrono>
 #include <stack>
 #include <random> // Added for shuffling
+#include <cstdint>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <queue>
+#include <functional>
+#include <deque>
+#include <memory>
+#include <climits>
+#include <list>
+#include <fstream>
+#include <sstream>
+#ifdef TIMETABLE_ZLIB
+#include <zlib.h>
+#endif
 
 using json = nlohmann::json;
 using namespace httplib;
 using namespace std;
 
-// --- Data Structures ---
+// --- Solution Cache ---
 
-struct Course {
-    string courseID, courseName, type;
-    string labType;
-    int duration;
-    bool allYear;
-};
+// 128-bit fingerprint (two independently seeded FNV-1a passes) as 32 hex digits.
+// Stable across runs and platforms, so it can name files of the on-disk store.
+string fingerprint(const string& bytes) {
+    uint64_t a = 0xcbf29ce484222325ULL, b = 0x84222325cbf29ce4ULL;
+    for (unsigned char c : bytes) {
+        a = (a ^ c) * 0x100000001b3ULL;
+        b = (b ^ c) * 0x100000001b3ULL;
+        b ^= b >> 29;
+    }
+    ostringstream out;
+    out << hex << setfill('0') << setw(16) << a << setw(16) << b;
+    return out.str();
+}
 
-struct Instructor {
-    string instructorID, name;
-    vector<string> qualifiedCourses;
-    vector<int> preferredTimeSlots;
-    vector<int> unavailableTimeSlots;
-};
+// Canonical form of a parsed model plus the options that change the answer. Entities are sorted
+// by ID (stably, so "first entry wins" on duplicate IDs is preserved) and set-like lists are
+// sorted, so payloads that differ only in order or type aliases describe the same problem.
+string canonicalProblem(const ProblemModel& model, const json& options) {
+    auto sortedInts = [](vector<int> v) { sort(v.begin(), v.end()); return v; };
+    auto sortedStrings = [](vector<string> v) { sort(v.begin(), v.end()); return v; };
+    auto byKey = [](json list, const char* key) {
+        stable_sort(list.begin(), list.end(), [key](const json& x, const json& y) { return x[key].get<string>() < y[key].get<string>(); });
+        return list;
+    };
+
+    json courses = json::array(), staff = json::array(), rooms = json::array(), sections = json::array();
+    for (auto& c : model.courses) courses.push_back({ {"id", c.courseID}, {"name", c.courseName}, {"type", c.type}, {"lab", c.labType}, {"dur", c.duration}, {"all", c.allYear} });
+    for (auto& i : model.instructors) staff.push_back({ {"id", i.instructorID}, {"name", i.name}, {"q", sortedStrings(i.qualifiedCourses)}, {"u", sortedInts(i.unavailableTimeSlots)}, {"p", sortedInts(i.preferredTimeSlots)} });
+    json tas = json::array();
+    for (auto& t : model.tas) tas.push_back({ {"id", t.taID}, {"name", t.name}, {"q", sortedStrings(t.qualifiedCourses)}, {"u", sortedInts(t.unavailableTimeSlots)}, {"p", sortedInts(t.preferredTimeSlots)} });
+    for (auto& r : model.rooms) rooms.push_back({ {"id", r.roomID}, {"type", r.type}, {"lab", r.labType}, {"cap", r.capacity} });
+    for (auto& s : model.sections) sections.push_back({ {"id", s.sectionID}, {"group", s.groupID}, {"year", s.year}, {"n", s.studentCount}, {"c", sortedStrings(s.assignedCourses)} });
+
+    json canonical;
+    canonical["courses"] = byKey(courses, "id");
+    canonical["instructors"] = byKey(staff, "id");
+    canonical["tas"] = byKey(tas, "id");
+    canonical["rooms"] = byKey(rooms, "id");
+    canonical["sections"] = byKey(sections, "id");
+    canonical["grid"] = { {"days", model.grid.days}, {"periodsPerDay", model.grid.periodsPerDay} };
+    canonical["options"] = options;
+    return canonical.dump(); // Object keys come out sorted
+}
 
-struct TA {
-    string taID, name;
-    vector<string> qualifiedCourses;
-    vector<int> preferredTimeSlots;
-    vector<int> unavailableTimeSlots;
-};
+// LRU of solved responses keyed by problem fingerprint, bounded by a byte budget. Raw request
+// bodies are aliased to their problem's key so an identical repost is answered without parsing.
+// With a directory configured, entries are also written to disk and reloaded after a restart.
+class SolutionCache {
+public:
+    SolutionCache(size_t byteBudget, string directory) : budget(byteBudget), directory(move(directory)) {}
+
+    bool enabled() const { return budget > 0; }
+
+    bool lookupRaw(const string& rawKey, string& body) {
+        if (!enabled()) return false;
+        lock_guard<mutex> guard(cacheMutex);
+        auto alias = aliases.find(rawKey);
+        if (alias == aliases.end() || !touch(alias->second, body)) return false;
+        rawHits++;
+        return true;
+    }
 
-struct Room {
-    string roomID, type;
-    string labType;
-    int capacity;
-};
+    bool lookup(const string& key, const string& rawKey, string& body) {
+        if (!enabled()) return false;
+        lock_guard<mutex> guard(cacheMutex);
+        if (touch(key, body) || loadFromDisk(key, body)) {
+            hits++;
+            addAlias(key, rawKey);
+            return true;
+        }
+        misses++;
+        return false;
+    }
 
-struct Section {
-    string sectionID, groupID;
-    int year, studentCount;
-    vector<string> assignedCourses;
-};
+    void store(const string& key, const string& rawKey, const string& body) {
+        if (!enabled() || entrySize(key, body) > budget) return;
+        lock_guard<mutex> guard(cacheMutex);
+        insert(key, body);
+        addAlias(key, rawKey);
+        if (!directory.empty()) {
+            ofstream file(directory + "/" + key + ".json", ios::binary);
+            file << body;
+        }
+    }
 
-struct Slot {
-    string courseID;
-    string type;
-    string roomID;
-    string instructorID;
-    int duration;
-    bool istaken;
-    bool isCont; // Is continuation of previous slot
+    json stats() {
+        lock_guard<mutex> guard(cacheMutex);
+        return { {"hits", hits}, {"rawHits", rawHits}, {"diskHits", diskHits}, {"misses", misses}, {"evictions", evictions},
+            {"entries", entries.size()}, {"bytes", bytes}, {"budgetBytes", budget}, {"persistent", !directory.empty()} };
+    }
 
-    Slot() : duration(0), istaken(false), isCont(false) {}
-};
+private:
+    struct Entry {
+        string key, body;
+        vector<string> rawKeys;
+    };
+
+    static size_t entrySize(const string& key, const string& body) { return key.size() + body.size() + 256; }
+
+    // Caller holds cacheMutex for all helpers below
+    bool touch(const string& key, string& body) {
+        auto it = index.find(key);
+        if (it == index.end()) return false;
+        entries.splice(entries.begin(), entries, it->second);
+        body = it->second->body;
+        return true;
+    }
 
-struct CSPVariable {
-    int id;
-    string courseID;
-    vector<int> targetSectionIndices; // Indices in the global 'sections' vector
-    int totalStudents;
+    bool loadFromDisk(const string& key, string& body) {
+        if (directory.empty()) return false;
+        ifstream file(directory + "/" + key + ".json", ios::binary);
+        if (!file) return false;
+        stringstream contents;
+        contents << file.rdbuf();
+        body = contents.str();
+        if (body.empty() || entrySize(key, body) > budget) return false;
+        insert(key, body);
+        diskHits++;
+        return true;
+    }
 
-    int duration;
-    bool isHardConstraint; // e.g., Fixed schedules
-};
+    void insert(const string& key, const string& body) {
+        auto it = index.find(key);
+        if (it != index.end()) {
+            entries.splice(entries.begin(), entries, it->second);
+            return;
+        }
+        entries.push_front({ key, body, {} });
+        index[key] = entries.begin();
+        bytes += entrySize(key, body);
+        while (bytes > budget && entries.size() > 1) {
+            Entry& victim = entries.back();
+            bytes -= entrySize(victim.key, victim.body);
+            for (const string& raw : victim.rawKeys) aliases.erase(raw);
+            index.erase(victim.key);
+            entries.pop_back();
+            evictions++;
+        }
+    }
+
+    void addAlias(const string& key, const string& rawKey) {
+        auto it = index.find(key);
+        if (rawKey.empty() || it == index.end() || aliases.count(rawKey)) return;
+        aliases[rawKey] = key;
+        it->second->rawKeys.push_back(rawKey);
+    }
 
-struct CSPValue {
-    int startSlot;
-    string instructorID;
-    string roomID;
+    size_t budget;
+    string directory;
+    mutex cacheMutex;
+    list<Entry> entries; // Most recently used first
+    unordered_map<string, list<Entry>::iterator> index;
+    unordered_map<string, string> aliases; // Raw body fingerprint -> problem key
+    size_t bytes = 0;
+    long long hits = 0, rawHits = 0, diskHits = 0, misses = 0, evictions = 0;
 };
 
-// --- Global Data Storage ---
-
-vector<Course> courses;
-vector<Instructor> instructors;
-vector<TA> tas;
-vector<Room> rooms;
-vector<Section> sections;
-
-const int SLOTS_MAX = 40;
-int SECTIONS_MAX;
-vector<vector<Slot>> Timetable;
-
-// Index maps
-unordered_map<string, int> sectionToIndex;
-unordered_map<string, vector<int>> groupToSectionIndices;
-unordered_map<int, vector<int>> yearToSectionIndices; // New: Map Year -> List of Section Indices
-unordered_map<string, Course> getCourse;
-
-// Constraint Sets
-unordered_set<string> instructorBusy[SLOTS_MAX];
-unordered_set<string> roomBusy[SLOTS_MAX];
-vector<unordered_set<string>> sectionScheduledCourses;
-
-string lastError = "";
-int iterationCount = 0;
-const int MAX_ITERATIONS = 2000000; // Reduced slightly to allow for retries
-const int MAX_RETRIES = 5;          // Number of times to shuffle and retry
-auto startTime = chrono::steady_clock::now();
-
-// --- Helper Functions ---
-
-string getInstructorName(string instructorID) {
-    for (auto& inst : instructors) if (inst.instructorID == instructorID) return inst.name;
-    for (auto& ta : tas) if (ta.taID == instructorID) return ta.name;
-    return "";
-}
+// --- Metrics ---
 
-bool isInstructorAvailable(string instructorID, int slot) {
-    if (instructorBusy[slot].count(instructorID)) return false;
+const double LATENCY_BUCKETS_S[] = { 0.001, 0.005, 0.01, 0.05, 0.1, 0.5, 1, 5, 10, 30, 60 };
+const int LATENCY_BUCKET_COUNT = sizeof(LATENCY_BUCKETS_S) / sizeof(LATENCY_BUCKETS_S[0]);
 
-    for (auto& inst : instructors) {
-        if (inst.instructorID == instructorID) {
-            for (int s : inst.unavailableTimeSlots) if (s == slot) return false;
-            return true;
-        }
-    }
-    for (auto& ta : tas) {
-        if (ta.taID == instructorID) {
-            for (int s : ta.unavailableTimeSlots) if (s == slot) return false;
-            return true;
-        }
-    }
-    return true;
-}
+struct LatencyHistogram {
+    long long counts[LATENCY_BUCKET_COUNT + 1] = {}; // The last bucket is above every bound
+    long long count = 0;
+    double sum = 0;
 
-bool isQualified(string instructorID, string courseID) {
-    for (auto& inst : instructors) {
-        if (inst.instructorID == instructorID) {
-            return find(inst.qualifiedCourses.begin(), inst.qualifiedCourses.end(), courseID) != inst.qualifiedCourses.end();
-        }
+    void observe(double seconds) {
+        int b = 0;
+        while (b < LATENCY_BUCKET_COUNT && seconds > LATENCY_BUCKETS_S[b]) b++;
+        counts[b]++;
+        count++;
+        sum += seconds;
     }
-    for (auto& ta : tas) {
-        if (ta.taID == instructorID) {
-            return find(ta.qualifiedCourses.begin(), ta.qualifiedCourses.end(), courseID) != ta.qualifiedCourses.end();
-        }
+
+    void merge(const LatencyHistogram& o) {
+        for (int b = 0; b <= LATENCY_BUCKET_COUNT; b++) counts[b] += o.counts[b];
+        count += o.count;
+        sum += o.sum;
     }
-    return false;
+};
+
+const int PHASE_COUNT = 6;
+const char* const PHASE_NAMES[PHASE_COUNT] = { "parse", "validate", "identify", "solve", "optimize", "serialize" };
+double PhaseTimings::* const PHASE_FIELDS[PHASE_COUNT] = { &PhaseTimings::parse, &PhaseTimings::validate, &PhaseTimings::identify,
+    &PhaseTimings::solve, &PhaseTimings::optimize, &PhaseTimings::serialize };
+
+json phasesToJson(const PhaseTimings& timings) {
+    json out;
+    out["queueWait"] = timings.queueWait;
+    for (int p = 0; p < PHASE_COUNT; p++) out[PHASE_NAMES[p]] = timings.*PHASE_FIELDS[p];
+    return out;
 }
 
-// --- Validation Logic (New) ---
+// What one request spent and did, recorded into the server metrics once its response is ready
+struct RequestStats {
+    PhaseTimings phases;
+    SolverCounters counters;
+    string result = "failed"; // solved, failed, invalid or cached
+};
 
-vector<string> validateInput() {
-    vector<string> errors;
+// Requests being solved right now, for the concurrency gauge
+class ActiveSolve {
+public:
+    explicit ActiveSolve(atomic<int>& active) : active(active) { active++; }
+    ~ActiveSolve() { active--; }
 
-    // 1. Check if assigned courses exist
-    for (const auto& sec : sections) {
-        for (const auto& cID : sec.assignedCourses) {
-            if (getCourse.find(cID) == getCourse.end()) {
-                errors.push_back("Section " + sec.sectionID + " is assigned unknown course: " + cID);
-            }
+private:
+    atomic<int>& active;
+};
+
+// Server-wide counters and histograms. Each thread records into its own shard, so requests never
+// contend on a shared counter; /api/metrics sums the shards when it is scraped.
+class ServerMetrics {
+public:
+    atomic<int> activeSolves{ 0 };
+
+    void record(const RequestStats& stats) {
+        Shard& shard = local();
+        lock_guard<mutex> guard(shard.lock);
+        shard.requests[stats.result]++;
+        shard.solver.merge(stats.counters);
+        for (int p = 0; p < PHASE_COUNT; p++) {
+            double ms = stats.phases.*PHASE_FIELDS[p];
+            if (ms > 0) shard.phases[p].observe(ms / 1000);
         }
     }
 
-    // 2. Check if every course has at least one qualified instructor
-    for (const auto& course : courses) {
-        bool hasQualified = false;
-        for (const auto& inst : instructors) {
-            if (isQualified(inst.instructorID, course.courseID)) {
-                hasQualified = true; break;
+    void recordQueueWait(double ms) {
+        Shard& shard = local();
+        lock_guard<mutex> guard(shard.lock);
+        shard.queueWait.observe(ms / 1000);
+    }
+
+    // Prometheus text exposition of everything recorded so far, plus the cache and queue gauges
+    string prometheus(const json& cacheStats, size_t queuedJobs) {
+        map<string, long long> requests;
+        SolverCounters solver;
+        LatencyHistogram phases[PHASE_COUNT], queueWait;
+        {
+            lock_guard<mutex> guard(shardsMutex);
+            for (auto& shard : shards) {
+                lock_guard<mutex> shardGuard(shard->lock);
+                for (auto& entry : shard->requests) requests[entry.first] += entry.second;
+                solver.merge(shard->solver);
+                for (int p = 0; p < PHASE_COUNT; p++) phases[p].merge(shard->phases[p]);
+                queueWait.merge(shard->queueWait);
             }
         }
-        if (!hasQualified) {
-            for (const auto& ta : tas) {
-                if (isQualified(ta.taID, course.courseID)) {
-                    hasQualified = true; break;
-                }
+
+        ostringstream out;
+        auto header = [&](const string& name, const char* type, const char* help) {
+            out << "# HELP " << name << " " << help << "\n# TYPE " << name << " " << type << "\n";
+        };
+        auto metric = [&](const string& name, const char* type, const char* help, double value) {
+            header(name, type, help);
+            out << name << " " << value << "\n";
+        };
+        auto histogram = [&](const string& name, const string& labels, const LatencyHistogram& h) {
+            long long cumulative = 0;
+            for (int b = 0; b < LATENCY_BUCKET_COUNT; b++) {
+                cumulative += h.counts[b];
+                out << name << "_bucket{" << labels << "le=\"" << LATENCY_BUCKETS_S[b] << "\"} " << cumulative << "\n";
             }
+            out << name << "_bucket{" << labels << "le=\"+Inf\"} " << h.count << "\n";
+            string plain = labels.empty() ? "" : "{" + labels.substr(0, labels.size() - 1) + "}";
+            out << name << "_sum" << plain << " " << h.sum << "\n" << name << "_count" << plain << " " << h.count << "\n";
+        };
+
+        header("timetable_requests_total", "counter", "Schedule and resolve requests by result.");
+        for (const char* result : { "solved", "failed", "invalid", "cached" }) {
+            out << "timetable_requests_total{result=\"" << result << "\"} " << requests[result] << "\n";
         }
-
-        if (!hasQualified) {
-            errors.push_back("Course " + course.courseName + " (" + course.courseID + ") has no qualified instructors or TAs.");
+        metric("timetable_active_solves", "gauge", "Requests being solved right now.", activeSolves.load());
+        metric("timetable_jobs_queued", "gauge", "Asynchronous jobs waiting for a worker.", queuedJobs);
+
+        metric("timetable_solver_iterations_total", "counter", "Solver iterations.", solver.iterations);
+        metric("timetable_solver_nodes_total", "counter", "Search nodes expanded (local search moves included).", solver.nodes);
+        metric("timetable_solver_backtracks_total", "counter", "Dead ends resolved by a backjump.", solver.backtracks);
+        metric("timetable_solver_max_depth", "gauge", "Most variables assigned at once by any solve.", solver.maxDepth);
+        metric("timetable_solver_valid_move_checks_total", "counter", "isValidMove calls.", solver.validMoveChecks);
+        metric("timetable_solver_symmetry_skips_total", "counter", "Candidate staff/rooms skipped as copies of an unused one.", solver.symmetrySkips);
+        header("timetable_solver_rejections_total", "counter", "Values rejected, by reason.");
+        pair<const char*, long long> rejections[] = { {"nogood", solver.nogoodRejections}, {"forward_check", solver.forwardCheckRejections},
+            {"instructor", solver.instructorRejections}, {"room", solver.roomRejections}, {"section", solver.sectionRejections} };
+        for (auto& r : rejections) out << "timetable_solver_rejections_total{reason=\"" << r.first << "\"} " << r.second << "\n";
+
+        header("timetable_solver_domain_size", "histogram", "Values each search node got to try before it succeeded or was exhausted.");
+        long long cumulative = 0, domainSum = 0;
+        for (int b = 0; b + 1 < DOMAIN_SIZE_BUCKETS; b++) {
+            cumulative += solver.domainSizes[b];
+            out << "timetable_solver_domain_size_bucket{le=\"" << (1 << b) - 1 << "\"} " << cumulative << "\n";
         }
+        cumulative += solver.domainSizes[DOMAIN_SIZE_BUCKETS - 1];
+        for (long long s : solver.depthDomainSum) domainSum += s;
+        out << "timetable_solver_domain_size_bucket{le=\"+Inf\"} " << cumulative << "\n";
+        out << "timetable_solver_domain_size_sum " << domainSum << "\ntimetable_solver_domain_size_count " << cumulative << "\n";
+
+        header("timetable_phase_duration_seconds", "histogram", "Wall time of each request phase.");
+        for (int p = 0; p < PHASE_COUNT; p++) histogram("timetable_phase_duration_seconds", string("phase=\"") + PHASE_NAMES[p] + "\",", phases[p]);
+        header("timetable_job_queue_wait_seconds", "histogram", "Time asynchronous jobs waited for a worker.");
+        histogram("timetable_job_queue_wait_seconds", "", queueWait);
+
+        metric("timetable_cache_hits_total", "counter", "Solution cache hits on the problem fingerprint, disk hits included.", cacheStats.value("hits", 0LL));
+        metric("timetable_cache_raw_hits_total", "counter", "Solution cache hits on the raw request body.", cacheStats.value("rawHits", 0LL));
+        metric("timetable_cache_disk_hits_total", "counter", "Solution cache hits loaded from disk.", cacheStats.value("diskHits", 0LL));
+        metric("timetable_cache_misses_total", "counter", "Solution cache misses.", cacheStats.value("misses", 0LL));
+        metric("timetable_cache_evictions_total", "counter", "Solutions evicted from the cache.", cacheStats.value("evictions", 0LL));
+        metric("timetable_cache_entries", "gauge", "Solutions held in the cache.", cacheStats.value("entries", 0LL));
+        metric("timetable_cache_bytes", "gauge", "Bytes held in the cache.", cacheStats.value("bytes", 0LL));
+        return out.str();
     }
 
-    return errors;
-}
-
-// --- CSP Logic ---
+private:
+    struct Shard {
+        mutex lock; // Only contended while a scrape reads this shard
+        map<string, long long> requests;
+        SolverCounters solver;
+        LatencyHistogram phases[PHASE_COUNT];
+        LatencyHistogram queueWait;
+    };
+
+    // The calling thread's shard, created on its first record
+    Shard& local() {
+        thread_local ServerMetrics* owner = nullptr;
+        thread_local Shard* shard = nullptr;
+        if (owner != this) {
+            lock_guard<mutex> guard(shardsMutex);
+            shards.push_back(make_unique<Shard>());
+            shard = shards.back().get();
+            owner = this;
+        }
+        return *shard;
+    }
 
-void applyMove(const CSPVariable& var, const CSPValue& val) {
-    string type = getCourse[var.courseID].type;
+    mutex shardsMutex;
+    vector<unique_ptr<Shard>> shards;
+};
 
-    for (int secIdx : var.targetSectionIndices) {
-        sectionScheduledCourses[secIdx].insert(var.courseID);
+// --- Response Encoding ---
 
-        Timetable[val.startSlot][secIdx].courseID = var.courseID;
-        Timetable[val.startSlot][secIdx].type = type;
-        Timetable[val.startSlot][secIdx].roomID = val.roomID;
-        Timetable[val.startSlot][secIdx].instructorID = val.instructorID;
-        Timetable[val.startSlot][secIdx].duration = var.duration;
-        Timetable[val.startSlot][secIdx].istaken = true;
-        Timetable[val.startSlot][secIdx].isCont = false;
+const size_t GZIP_MIN_BYTES = 1024; // Smaller bodies are sent as they are
 
-        for (int i = 1; i < var.duration; i++) {
-            Timetable[val.startSlot + i][secIdx].courseID = var.courseID;
-            Timetable[val.startSlot + i][secIdx].type = type;
-            Timetable[val.startSlot + i][secIdx].roomID = val.roomID;
-            Timetable[val.startSlot + i][secIdx].instructorID = val.instructorID;
-            Timetable[val.startSlot + i][secIdx].duration = var.duration;
-            Timetable[val.startSlot + i][secIdx].istaken = true;
-            Timetable[val.startSlot + i][secIdx].isCont = true;
-        }
-    }
+// Body format from the Accept header; JSON unless the client asks for CBOR or MessagePack
+WireFormat negotiateFormat(const Request& req) {
+    string accept = req.get_header_value("Accept");
+    if (accept.find("application/cbor") != string::npos) return WireFormat::Cbor;
+    if (accept.find("msgpack") != string::npos) return WireFormat::MsgPack; // application/msgpack, x-msgpack, vnd.msgpack
+    return WireFormat::Json;
+}
 
-    for (int s = val.startSlot; s < val.startSlot + var.duration; s++) {
-        instructorBusy[s].insert(val.instructorID);
-        if (val.roomID != "") roomBusy[s].insert(val.roomID);
+const char* contentType(WireFormat format) {
+    switch (format) {
+    case WireFormat::Cbor: return "application/cbor";
+    case WireFormat::MsgPack: return "application/msgpack";
+    default: return "application/json";
     }
 }
 
-void undoMove(const CSPVariable& var, const CSPValue& val) {
-    for (int secIdx : var.targetSectionIndices) {
-        sectionScheduledCourses[secIdx].erase(var.courseID);
-        for (int s = val.startSlot; s < val.startSlot + var.duration; s++) {
-            Timetable[s][secIdx] = Slot();
-        }
+#ifdef TIMETABLE_ZLIB
+bool gzipCompress(const string& input, string& output) {
+    z_stream zs = {};
+    if (deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) return false; // +16: gzip wrapper
+    output.resize(deflateBound(&zs, input.size()));
+    zs.next_in = (Bytef*)input.data();
+    zs.avail_in = (uInt)input.size();
+    zs.next_out = (Bytef*)&output[0];
+    zs.avail_out = (uInt)output.size();
+    int result = deflate(&zs, Z_FINISH);
+    output.resize(zs.total_out);
+    deflateEnd(&zs);
+    return result == Z_STREAM_END;
+}
+#endif
+
+// Sets an encoded body, gzipped when the client accepts it and the build has zlib
+void sendBody(const Request& req, Response& res, string body, WireFormat format) {
+    res.set_header("Vary", "Accept, Accept-Encoding");
+#ifdef TIMETABLE_ZLIB
+    string compressed;
+    if (body.size() >= GZIP_MIN_BYTES && req.get_header_value("Accept-Encoding").find("gzip") != string::npos && gzipCompress(body, compressed)) {
+        res.set_header("Content-Encoding", "gzip");
+        body = move(compressed);
     }
+#else
+    (void)req;
+#endif
+    res.set_content(move(body), contentType(format));
+}
 
-    for (int s = val.startSlot; s < val.startSlot + var.duration; s++) {
-        instructorBusy[s].erase(val.instructorID);
-        if (val.roomID != "") roomBusy[s].erase(val.roomID);
-    }
+void sendJson(const Request& req, Response& res, const json& body) {
+    WireFormat format = negotiateFormat(req);
+    sendBody(req, res, encodeJson(body, format), format);
 }
 
-bool isValidMove(const CSPVariable& var, const CSPValue& val) {
-    if (val.startSlot + var.duration > SLOTS_MAX) return false;
-    // Constraint: Slots larger than 1 hour should align (heuristic, optional)
-    // if (var.duration > 1 && val.startSlot % var.duration != 0) return false; 
+// A schedule response: the small JSON part, plus the solved timetable, which is streamed into it
+// on encoding. Failures and cache hits have no timetable and are all in `body`.
+struct ScheduleResponse {
+    json body = json::object();
+    // Writes the timetable with the given extra members; holds the solved state of whichever mask width ran
+    function<void(WireWriter&, const json&)> timetable;
+
+    ScheduleResponse() = default;
+    ScheduleResponse(json body) : body(move(body)) {} // A response without a timetable
 
-    for (int s = val.startSlot; s < val.startSlot + var.duration; s++) {
-        if (!isInstructorAvailable(val.instructorID, s)) return false;
+    template <class Mask>
+    void setTimetable(SolverState<Mask>&& st) {
+        auto solved = make_shared<const SolverState<Mask>>(move(st));
+        timetable = [solved](WireWriter& writer, const json& extra) { writeTimetable(writer, *solved, extra); };
     }
 
-    if (val.roomID != "") {
-        for (int s = val.startSlot; s < val.startSlot + var.duration; s++) {
-            if (roomBusy[s].count(val.roomID)) return false;
-        }
+    string encode(WireFormat format) const {
+        if (!timetable) return encodeJson(body, format);
+        WireWriter writer(format);
+        timetable(writer, body);
+        return move(writer.bytes());
     }
 
-    for (int secIdx : var.targetSectionIndices) {
-        for (int s = val.startSlot; s < val.startSlot + var.duration; s++) {
-            if (Timetable[s][secIdx].istaken) return false;
-        }
+    // DOM of the response, for callers that keep or amend it; decoded from the compact writer
+    // output so both share one layout
+    json toJson() const {
+        if (!timetable) return body;
+        WireWriter writer(WireFormat::Cbor);
+        timetable(writer, body);
+        return json::from_cbor(writer.bytes());
     }
+};
 
-    return true;
+// --- Request Handling ---
+
+// Response body for a request body that parseInputStream() rejected
+json invalidBodyResponse(const string& error) {
+    json response;
+    response["success"] = false;
+    response["error"] = "Invalid request body";
+    response["details"] = json::array({ error });
+    return response;
 }
 
-vector<CSPValue> generateDomain(const CSPVariable& var) {
-    vector<CSPValue> domain;
-    const Course& c = getCourse[var.courseID];
+// Options that change the answer, hashed into the cache key along with the problem
+json cacheKeyOptions(const json& options) {
+    return { {"engine", options.value("engine", "backtrack")}, {"variableOrdering", options.value("variableOrdering", "domwdeg")},
+        {"optimize", options.value("optimize", json(false))}, {"seed", options.value("seed", 0u)}, {"decompose", options.value("decompose", true)} };
+}
 
-    vector<string> qualifiedInstructors;
-    for (auto& inst : instructors) if (isQualified(inst.instructorID, var.courseID)) qualifiedInstructors.push_back(inst.instructorID);
-    for (auto& ta : tas) if (isQualified(ta.taID, var.courseID)) qualifiedInstructors.push_back(ta.taID);
+// Diagnostics of a response answered from the cache. Cached bodies carry none of their own, since
+// the attempts, strategy and timings of the original solve say nothing about this request.
+json cacheHitDiagnostics(chrono::steady_clock::time_point requestStart) {
+    return { {"cache", "hit"}, {"timeTakenMs", chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - requestStart).count()} };
+}
 
-    if (qualifiedInstructors.empty()) return domain;
+// "optimize": true, or { "timeLimitMs": ..., "weights": { "preference", "gaps", "dailyLoad" } }.
+// Sets the weights of an optimizing request; other requests keep the given ones.
+void applyObjectiveWeights(const json& options, ObjectiveWeights& weights) {
+    json optimize = options.value("optimize", json(false));
+    if (!optimize.is_object() && !(optimize.is_boolean() && optimize.get<bool>())) return;
+    json given = optimize.is_object() ? optimize.value("weights", json::object()) : json::object();
+    weights.preference = given.value("preference", DEFAULT_WEIGHTS.preference);
+    weights.gaps = given.value("gaps", DEFAULT_WEIGHTS.gaps);
+    weights.dailyLoad = given.value("dailyLoad", DEFAULT_WEIGHTS.dailyLoad);
+}
 
-    vector<string> qualifiedRooms;
-    // Specific hardcoded constraint for GRAD courses if needed
-    if (var.courseID == "GRAD1" || var.courseID == "GRAD2") {
-        qualifiedRooms.push_back("");
-    }
-    else {
-        for (auto& room : rooms) {
-            if (room.type != c.type) continue;
-            if (c.type == "Lab" && !c.labType.empty() && room.labType != c.labType) continue;
-            // Capacity Check: Must hold total students of all combined sections
-            if (room.capacity < var.totalStudents) continue;
-            qualifiedRooms.push_back(room.roomID);
+// Solves a compiled and checked problem whose objective weights are set. A non-empty cacheKey is
+// looked up first, and a solution stored under it (and under rawKey if given).
+ScheduleResponse solveProblem(const ProblemModel& model, const vector<CSPVariable>& variables, const json& options, WorkerPool& solverPool, int defaultThreads,
+    const SolveControl& requestControl, RequestStats& stats, int& status, chrono::steady_clock::time_point requestStart, SolutionCache* cache, const string& cacheKey, const string& rawKey) {
+    bool withDiagnostics = options.value("diagnostics", false);
+
+    // The optimize time limit counts from the start of the request and bounds the improvement phase
+    json optimize = options.value("optimize", json(false));
+    bool optimizing = optimize.is_object() || (optimize.is_boolean() && optimize.get<bool>());
+    long long optimizeTimeMs = !optimizing ? 0 : optimize.is_object() ? optimize.value("timeLimitMs", DEFAULT_OPTIMIZE_MS) : DEFAULT_OPTIMIZE_MS;
+
+    VariableOrdering ordering = parseVariableOrdering(options.value("variableOrdering", "domwdeg"));
+    SolverEngine engine = parseSolverEngine(options.value("engine", "backtrack"));
+    int threads = min(options.value("threads", defaultThreads), solverPool.size());
+    bool decompose = options.value("decompose", true); // Independent components solved separately
+    SolveControl control = requestControl;
+    control.seed = options.value("seed", 0u);
+    if (control.progress) control.progress->variables = variables.size();
+
+    if (!cacheKey.empty()) {
+        string cached;
+        if (cache->lookup(cacheKey, rawKey, cached)) {
+            ScheduleResponse response(json::parse(cached));
+            response.body["diagnostics"] = cacheHitDiagnostics(requestStart);
+            if (withDiagnostics) response.body["diagnostics"]["phasesMs"] = phasesToJson(stats.phases); // No search ran
+            stats.result = "cached";
+            status = 200;
+            return response;
         }
     }
 
-    if (qualifiedRooms.empty() && var.courseID != "GRAD1" && var.courseID != "GRAD2") return domain;
+    if (control.trace) control.traceRequest = control.trace->beginRequest();
+    cout << "Starting CSP Solver..." << endl;
+    cout << "Variables to schedule: " << variables.size() << endl;
+
+    // 4. Solve: independent components in parallel, serial retries, or a portfolio of concurrent
+    // instances, with the solver compiled for the narrowest mask width that holds the week grid
+    return withSlotMask(model.grid, [&](auto widthTag) {
+        typedef decltype(widthTag) Mask;
+        auto phaseStart = chrono::steady_clock::now();
+        SolveOutcome<Mask> outcome = decompose
+            ? solveDecomposed<Mask>(solverPool, model, variables, ordering, engine, threads, control)
+            : threads > 1
+            ? solvePortfolio<Mask>(solverPool, model, variables, ordering, engine, threads, control)
+            : solveWithRetries<Mask>(model, variables, ordering, engine, control);
+        bool success = outcome.success;
+        SolverState<Mask>& st = outcome.state;
+        stats.phases.solve = elapsedMs(phaseStart);
+
+        // 5. Anytime improvement of the soft constraints until the deadline
+        json objective;
+        if (success && optimizing) {
+            phaseStart = chrono::steady_clock::now();
+            ObjectiveTerms initial = evaluateObjective(st, variables);
+            int improvements = improveTimetable(st, variables, requestStart + chrono::milliseconds(optimizeTimeMs), solveSeed(control));
+            ObjectiveTerms improved = evaluateObjective(st, variables);
+            objective["initialScore"] = weightedObjective(model.weights, initial);
+            objective["score"] = weightedObjective(model.weights, improved);
+            objective["preferenceViolations"] = improved.preference;
+            objective["gapPeriods"] = improved.gaps;
+            objective["dailyLoad"] = improved.dailyLoad;
+            objective["improvements"] = improvements;
+            stats.phases.optimize = elapsedMs(phaseStart);
+        }
+        stats.counters = outcome.counters;
 
-    for (int slot = 0; slot <= SLOTS_MAX - c.duration; slot++) {
+        auto endTime = chrono::steady_clock::now();
+        auto duration = chrono::duration_cast<chrono::milliseconds>(endTime - requestStart).count();
 
-        // Check Section Availability first
-        bool sectionsFree = true;
-        for (int secIdx : var.targetSectionIndices) {
-            for (int s = slot; s < slot + c.duration; s++) {
-                if (Timetable[s][secIdx].istaken) { sectionsFree = false; break; }
-            }
-            if (!sectionsFree) break;
+        ScheduleResponse response;
+        if (success) {
+            response.setTimetable(move(st));
+            if (optimizing) response.body["objective"] = objective;
+            cout << "SUCCESS: Timetable generated in " << duration << "ms (Attempts: " << outcome.attempts << ", Strategy: " << outcome.strategy << ")" << endl;
+        }
+        else {
+            response.body["success"] = false;
+            response.body["error"] = st.lastError.empty() ? "No valid solution found after multiple attempts." : st.lastError;
+            response.body["iterations"] = st.iterationCount;
+            response.body["attempts"] = outcome.attempts;
+            cout << "FAILED: " << st.lastError << endl;
         }
-        if (!sectionsFree) continue;
 
-        for (const string& instID : qualifiedInstructors) {
-            // Optimization: check instructor availability before checking rooms
-            bool instFree = true;
-            for (int s = slot; s < slot + c.duration; s++) {
-                if (!isInstructorAvailable(instID, s)) { instFree = false; break; }
-            }
-            if (!instFree) continue;
+        response.body["diagnostics"]["timeTakenMs"] = duration;
+        response.body["diagnostics"]["totalAttempts"] = outcome.attempts;
+        response.body["diagnostics"]["strategy"] = outcome.strategy;
+        response.body["diagnostics"]["threads"] = max(threads, 1);
+        response.body["diagnostics"]["components"] = outcome.components;
+        response.body["diagnostics"]["engine"] = solverEngineName(engine);
+        if (control.trace) response.body["diagnostics"]["traceRequest"] = control.traceRequest;
+
+        // Only solutions are cached: a failure may just be a timeout that a retry could beat
+        if (success && !cacheKey.empty()) {
+            phaseStart = chrono::steady_clock::now();
+            json diagnostics = move(response.body["diagnostics"]);
+            response.body.erase("diagnostics"); // Describes this solve, not the requests the entry will answer
+            cache->store(cacheKey, rawKey, response.encode(WireFormat::Json));
+            response.body["diagnostics"] = move(diagnostics);
+            stats.phases.serialize += elapsedMs(phaseStart);
+            response.body["diagnostics"]["cache"] = "miss";
+        }
+        if (withDiagnostics) {
+            response.body["diagnostics"]["search"] = countersToJson(stats.counters);
+            response.body["diagnostics"]["phasesMs"] = phasesToJson(stats.phases);
+        }
 
-            for (const string& roomID : qualifiedRooms) {
-                CSPValue val;
-                val.startSlot = slot;
-                val.instructorID = instID;
-                val.roomID = roomID;
+        stats.result = success ? "solved" : "failed";
+        status = success ? 200 : 400;
+        return response;
+    });
+}
 
-                if (isValidMove(var, val)) {
-                    domain.push_back(val);
-                }
-            }
-        }
+// Validates, compiles and solves one parsed schedule request (its model and the request options).
+// Returns the response and sets the HTTP status (200 solved, 400 invalid or unsolvable).
+// Solved responses are cached as compact JSON under the problem's fingerprint, and under rawKey if given.
+// Phase times and search counters go to `stats`; "diagnostics": true also puts them in the response.
+ScheduleResponse runScheduleRequest(ProblemModel& model, const json& options, WorkerPool& solverPool, int defaultThreads, const SolveControl& requestControl, RequestStats& stats, int& status, SolutionCache* cache = nullptr, const string& rawKey = "") {
+    auto requestStart = chrono::steady_clock::now();
+    vector<CSPVariable> variables;
+    json errResponse;
+    if (!compileProblem(model, variables, errResponse, &stats.phases)) {
+        stats.result = "invalid";
+        status = 400;
+        return { errResponse };
     }
+    applyObjectiveWeights(options, model.weights);
 
-    // Heuristic: Shuffle domain to add randomness during retries could be added here, 
-    // but the main shuffle happens at variable ordering.
-    return domain;
+    // Identical problems (same model, options and seed) are answered from the cache
+    string cacheKey = cache && cache->enabled() ? fingerprint(canonicalProblem(model, cacheKeyOptions(options))) : "";
+    return solveProblem(model, variables, options, solverPool, defaultThreads, requestControl, stats, status, requestStart, cache, cacheKey, rawKey);
 }
 
-// --- Variable Identification (Modified for allYear logic) ---
+// Re-solves a previous timetable after a small input change, moving as few classes as possible.
+// Body: { "data": <full request body>, "delta": <see applyInputDelta>, "previous": <prior response> }
+// The model is the caller's, as the returned timetable refers to it.
+ScheduleResponse runResolveRequest(const json& body, ProblemModel& model, const SolveControl& requestControl, RequestStats& stats, int& status) {
+    auto requestStart = chrono::steady_clock::now();
+    SolveControl control = requestControl;
+    if (control.trace) control.traceRequest = control.trace->beginRequest();
+    json inputData = body.value("data", json::object());
+    if (body.contains("delta")) applyInputDelta(inputData, body["delta"]);
 
-vector<CSPVariable> identifyVariables() {
     vector<CSPVariable> variables;
-    int varIdCounter = 0;
-
-    unordered_set<string> processedGroupCourses;
-    unordered_set<string> processedYearCourses; // Track yearly courses
-
-    for (int i = 0; i < sections.size(); i++) {
-        Section& sec = sections[i];
+    json errResponse;
+    if (!buildProblem(inputData, model, variables, errResponse, &stats.phases)) {
+        stats.result = "invalid";
+        status = 400;
+        return { errResponse };
+    }
+    if (control.progress) control.progress->variables = variables.size();
+    vector<CSPValue> previous = previousAssignment(model, variables, body.value("previous", json::object()));
+
+    return withSlotMask(model.grid, [&](auto widthTag) {
+        typedef decltype(widthTag) Mask;
+        auto phaseStart = chrono::steady_clock::now();
+        SolverState<Mask> st;
+        st.model = &model;
+        st.control = control;
+        st.startTime = requestStart;
+        int freedCount = 0, rounds = 0;
+        bool success = resolveFromPrevious(st, variables, previous, freedCount, rounds);
+        stats.counters = st.counters;
+        if (!success && !(control.abortFlag && control.abortFlag->load())) {
+            // Last resort: a cold solve, which gives up on keeping the old timetable
+            SolveOutcome<Mask> outcome = solveWithRetries<Mask>(model, variables, VariableOrdering::DomWdeg, SolverEngine::Backtrack, control);
+            success = outcome.success;
+            st = move(outcome.state);
+            stats.counters.merge(outcome.counters);
+            freedCount = variables.size();
+            rounds++;
+        }
+        stats.phases.solve = elapsedMs(phaseStart);
+
+        auto duration = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - requestStart).count();
+        ScheduleResponse response;
+        if (success) {
+            int changed = 0;
+            for (size_t v = 0; v < variables.size(); v++) changed += !(st.assignedValue[v] == previous[v]);
+            response.body["resolve"]["kept"] = (int)variables.size() - changed;
+            response.body["resolve"]["changed"] = changed;
+            response.body["resolve"]["freed"] = freedCount;
+            response.body["resolve"]["rounds"] = rounds;
+            cout << "RESOLVED: " << changed << " of " << variables.size() << " classes moved in " << duration << "ms" << endl;
+            response.setTimetable(move(st));
+        }
+        else {
+            response.body["success"] = false;
+            response.body["error"] = st.lastError.empty() ? "Unable to repair the previous timetable." : st.lastError;
+            response.body["iterations"] = st.iterationCount;
+            cout << "RESOLVE FAILED: " << st.lastError << endl;
+        }
+        response.body["diagnostics"]["timeTakenMs"] = duration;
+        if (control.trace) response.body["diagnostics"]["traceRequest"] = control.traceRequest;
+        if (inputData.value("diagnostics", false) || body.value("diagnostics", false)) {
+            response.body["diagnostics"]["search"] = countersToJson(stats.counters);
+            response.body["diagnostics"]["phasesMs"] = phasesToJson(stats.phases);
+        }
+        stats.result = success ? "solved" : "failed";
+        status = success ? 200 : 400;
+        return response;
+    });
+}
 
-        for (const string& cID : sec.assignedCourses) {
-            if (getCourse.find(cID) == getCourse.end()) continue;
-            Course& c = getCourse[cID];
+// --- Scenario Batches ---
+
+const size_t MAX_BATCH_SCENARIOS = 256;
+
+// One /api/schedule/batch request: its base problem, compiled once, and the finished scenario
+// results waiting to be streamed. Scenario tasks share it, so it outlives a client that hangs up.
+struct ScenarioBatch {
+    ProblemVariant base;
+    json options;         // The base request's options; a scenario's "options" are merged over them
+    string baseCanonical; // canonicalProblem() of the base, when the cache is on
+    json baseData;        // The base body, kept only when some scenario changes sections
+    atomic<bool> cancel{ false }; // Set when the client goes away
+    chrono::steady_clock::time_point start;
+
+    mutex linesMutex;
+    condition_variable linesReady;
+    deque<string> lines;  // Finished NDJSON lines not sent yet
+    size_t pending = 0;   // Scenarios not finished yet
+    int succeeded = 0;
+};
 
-            if (c.allYear) {
-                // New Logic: Group by Year
-                string yearKey = to_string(sec.year) + "_" + cID;
-                if (processedYearCourses.count(yearKey)) continue;
+json invalidScenarioResponse(const string& error) {
+    return { {"success", false}, {"error", "Invalid scenario"}, {"details", json::array({ error })} };
+}
 
-                CSPVariable var;
-                var.id = varIdCounter++;
-                var.courseID = cID;
-                var.isHardConstraint = (cID == "GRAD1" || cID == "GRAD2");
-                var.duration = c.duration;
+// NDJSON line of a finished scenario; `result` is its encoded response body
+string scenarioLine(size_t index, const json& scenario, int status, const string& result) {
+    json id = scenario.value("id", json(index));
+    return "{\"index\":" + to_string(index) + ",\"id\":" + id.dump() + ",\"status\":" + to_string(status) + ",\"result\":" + result + "}\n";
+}
 
-                // Get all sections for this year
-                if (yearToSectionIndices.count(sec.year)) {
-                    var.targetSectionIndices = yearToSectionIndices[sec.year];
-                }
-                else {
-                    var.targetSectionIndices.push_back(i); // Fallback
-                }
+// Builds and solves one scenario of a batch: { "id", "delta": <see applyInputDelta>, "options" }.
+// Deltas that keep entity indices are overlaid on the shared base; section changes rebuild the
+// scenario from the base body. Returns its NDJSON line, { "index", "id", "status", "result" },
+// where the result is what /api/schedule would have answered.
+string runScenario(ScenarioBatch& batch, size_t index, const json& scenario, WorkerPool& solverPool, const SolveControl& control, RequestStats& stats, int& status, SolutionCache* cache) {
+    auto requestStart = chrono::steady_clock::now();
+    json delta = scenario.value("delta", json::object());
+    string deltaError;
+    if (!checkInputDelta(delta, deltaError)) {
+        stats.result = "invalid";
+        status = 400;
+        return scenarioLine(index, scenario, status, invalidScenarioResponse(deltaError).dump());
+    }
+    json options = batch.options;
+    if (scenario.contains("options") && scenario["options"].is_object()) options.update(scenario["options"]);
+    ObjectiveWeights weights;
+    applyObjectiveWeights(options, weights);
+
+    ProblemVariant problem;
+    json errResponse;
+    bool valid;
+    if (isVariantDelta(delta)) {
+        problem = applyVariantDelta(batch.base, delta);
+        stats.phases.identify = elapsedMs(requestStart);
+        valid = checkProblem(*problem.model, *problem.variables, errResponse, &stats.phases);
+        const ObjectiveWeights& shared = problem.model->weights;
+        if (shared.preference != weights.preference || shared.gaps != weights.gaps || shared.dailyLoad != weights.dailyLoad) {
+            auto model = make_shared<ProblemModel>(*problem.model);
+            model->weights = weights;
+            problem.model = model;
+        }
+    }
+    else {
+        json data = batch.baseData;
+        applyInputDelta(data, delta);
+        auto model = make_shared<ProblemModel>();
+        auto variables = make_shared<vector<CSPVariable>>();
+        valid = buildProblem(data, *model, *variables, errResponse, &stats.phases);
+        model->weights = weights;
+        problem = { model, variables };
+    }
 
-                var.totalStudents = 0;
-                for (int idx : var.targetSectionIndices) var.totalStudents += sections[idx].studentCount;
+    ScheduleResponse response;
+    if (!valid) {
+        stats.result = "invalid";
+        status = 400;
+        response = { errResponse };
+    }
+    else {
+        // The base is hashed once per batch; a scenario's key adds its delta and options
+        string cacheKey = batch.baseCanonical.empty() ? "" : fingerprint(batch.baseCanonical + delta.dump() + cacheKeyOptions(options).dump());
+        response = solveProblem(*problem.model, *problem.variables, options, solverPool, 1, control, stats, status, requestStart, cache, cacheKey, "");
+    }
+    return scenarioLine(index, scenario, status, response.encode(WireFormat::Json));
+}
 
-                variables.push_back(var);
-                processedYearCourses.insert(yearKey);
-            }
-            else if (c.type == "Lecture") {
-                // Existing Logic: Group by GroupID
-                string groupKey = sec.groupID + "_" + cID;
-                if (processedGroupCourses.count(groupKey)) continue;
-
-                CSPVariable var;
-                var.id = varIdCounter++;
-                var.courseID = cID;
-                var.isHardConstraint = (cID == "GRAD1" || cID == "GRAD2");
-                var.duration = c.duration;
-
-                if (groupToSectionIndices.count(sec.groupID)) {
-                    var.targetSectionIndices = groupToSectionIndices[sec.groupID];
-                }
-                else {
-                    var.targetSectionIndices.push_back(i);
-                }
+// --- Job Queue ---
 
-                var.totalStudents = 0;
-                for (int idx : var.targetSectionIndices) var.totalStudents += sections[idx].studentCount;
+enum class JobStatus { Queued, Running, Succeeded, Failed, Cancelled };
 
-                variables.push_back(var);
-                processedGroupCourses.insert(groupKey);
-            }
-            else {
-                // Individual Sections (Labs/Tutorials usually)
-                CSPVariable var;
-                var.id = varIdCounter++;
-                var.courseID = cID;
-                var.targetSectionIndices.push_back(i);
-                var.totalStudents = sec.studentCount;
-                var.duration = c.duration;
-                var.isHardConstraint = false;
-
-                variables.push_back(var);
-            }
-        }
+string jobStatusName(JobStatus status) {
+    switch (status) {
+    case JobStatus::Queued: return "queued";
+    case JobStatus::Running: return "running";
+    case JobStatus::Succeeded: return "succeeded";
+    case JobStatus::Failed: return "failed";
+    default: return "cancelled";
     }
-
-    return variables;
 }
 
-// --- Solver ---
+// One asynchronous schedule request. The fields under `lock` change as the job moves through
+// the queue; cancel and progress are shared lock-free with the running solver.
+struct ScheduleJob {
+    string id;
+    int priority = 0;
+    uint64_t sequence = 0;
+    ProblemModel model; // Parsed at submission
+    json options;
+    double parseMs = 0;
+    atomic<bool> cancel{ false };
+    SolveProgress progress;
+
+    mutex lock;
+    JobStatus status = JobStatus::Queued;
+    json result;
+    int resultStatus = 0;
+    chrono::steady_clock::time_point submittedAt, startedAt, finishedAt;
+};
 
-bool solveIterative(vector<CSPVariable>& variables) {
-    int n = variables.size();
-    if (n == 0) return true;
+const size_t MAX_FINISHED_JOBS = 256; // Finished jobs kept for status queries, oldest dropped first
+
+json jobToJson(ScheduleJob& job) {
+    lock_guard<mutex> guard(job.lock);
+    auto now = chrono::steady_clock::now();
+    auto ms = [](chrono::steady_clock::duration d) { return chrono::duration_cast<chrono::milliseconds>(d).count(); };
+
+    json out;
+    out["jobID"] = job.id;
+    out["status"] = jobStatusName(job.status);
+    out["priority"] = job.priority;
+    out["progress"]["iterations"] = job.progress.iterations.load();
+    out["progress"]["depth"] = job.progress.depth.load();
+    out["progress"]["bestDepth"] = job.progress.bestDepth.load();
+    out["progress"]["variables"] = job.progress.variables.load();
+    out["progress"]["attempts"] = job.progress.attempts.load();
+
+    bool started = job.status != JobStatus::Queued && job.startedAt.time_since_epoch().count() != 0;
+    bool finished = job.status != JobStatus::Queued && job.status != JobStatus::Running;
+    out["queuedMs"] = ms((started ? job.startedAt : (finished ? job.finishedAt : now)) - job.submittedAt);
+    if (started) out["runMs"] = ms((finished ? job.finishedAt : now) - job.startedAt);
+    if (!job.result.is_null()) out["result"] = job.result;
+    return out;
+}
 
-    vector<vector<CSPValue>> domains(n);
-    vector<int> domainIndices(n, -1);
-    int depth = 0;
+// Bounded priority queue of schedule jobs drained by a fixed set of workers. Higher priority
+// runs first, FIFO within a priority. Submissions beyond the capacity are refused, so the
+// backlog (and the wait behind it) stays bounded instead of piling up under load.
+class JobQueue {
+public:
+    typedef function<json(ScheduleJob&, int&)> Runner;
 
-    domains[0] = generateDomain(variables[0]);
+    JobQueue(int workers, size_t capacity, Runner run) : capacity(capacity), run(move(run)), idGenerator(random_device()()) {
+        for (int i = 0; i < max(1, workers); i++) threads.emplace_back([this]() { workerLoop(); });
+    }
 
-    while (depth >= 0 && depth < n) {
-        auto currentTime = chrono::steady_clock::now();
-        // Global timeout check
-        if (chrono::duration_cast<chrono::seconds>(currentTime - startTime).count() > 30) {
-            lastError = "Timeout limit reached.";
-            return false;
+    ~JobQueue() {
+        {
+            lock_guard<mutex> guard(queueMutex);
+            stopping = true;
+            for (auto& entry : jobs) entry.second->cancel = true;
         }
+        queueReady.notify_all();
+        for (thread& worker : threads) worker.join();
+    }
 
-        iterationCount++;
-        if (iterationCount > MAX_ITERATIONS) {
-            lastError = "Max iterations reached.";
-            return false;
+    // Returns nullptr when the queue is full
+    shared_ptr<ScheduleJob> submit(ProblemModel model, json options, int priority, double parseMs) {
+        auto job = make_shared<ScheduleJob>();
+        {
+            lock_guard<mutex> guard(queueMutex);
+            if (queuedCount >= capacity) return nullptr;
+            ostringstream id;
+            id << "job-" << hex << setw(16) << setfill('0') << idGenerator();
+            job->id = id.str();
+            job->priority = priority;
+            job->sequence = nextSequence++;
+            job->model = move(model);
+            job->options = move(options);
+            job->parseMs = parseMs;
+            job->submittedAt = chrono::steady_clock::now();
+            jobs[job->id] = job;
+            pending.push(job);
+            queuedCount++;
         }
+        queueReady.notify_one();
+        return job;
+    }
 
-        bool foundAssignment = false;
-
-        while (true) {
-            domainIndices[depth]++;
+    shared_ptr<ScheduleJob> find(const string& id) {
+        lock_guard<mutex> guard(queueMutex);
+        auto it = jobs.find(id);
+        return it == jobs.end() ? nullptr : it->second;
+    }
 
-            if (domainIndices[depth] >= domains[depth].size()) {
-                break;
-            }
+    // A queued job is cancelled at once; a running one stops at the solver's next check.
+    // Returns the status the job had when the request arrived.
+    JobStatus cancel(const shared_ptr<ScheduleJob>& job) {
+        lock_guard<mutex> guard(queueMutex);
+        lock_guard<mutex> jobGuard(job->lock);
+        JobStatus previous = job->status;
+        if (previous == JobStatus::Queued) {
+            job->status = JobStatus::Cancelled;
+            job->finishedAt = chrono::steady_clock::now();
+            job->model = ProblemModel();
+            job->options = json();
+            queuedCount--;
+            retire(job->id);
+        }
+        if (previous == JobStatus::Queued || previous == JobStatus::Running) job->cancel = true;
+        return previous;
+    }
 
-            CSPValue& val = domains[depth][domainIndices[depth]];
+    size_t queued() {
+        lock_guard<mutex> guard(queueMutex);
+        return queuedCount;
+    }
 
-            // Basic forward check happens inside isValidMove called during Apply? 
-            // Here we just assume domain generation filtered basics.
-            // But we must check against CURRENT state (which changes during recursion)
-            if (isValidMove(variables[depth], val)) {
-                applyMove(variables[depth], val);
-                foundAssignment = true;
-                break;
-            }
+private:
+    struct JobOrder {
+        bool operator()(const shared_ptr<ScheduleJob>& a, const shared_ptr<ScheduleJob>& b) const {
+            if (a->priority != b->priority) return a->priority < b->priority;
+            return a->sequence > b->sequence;
         }
+    };
 
-        if (foundAssignment) {
-            depth++;
-            if (depth < n) {
-                domains[depth] = generateDomain(variables[depth]);
-                domainIndices[depth] = -1;
-
-                if (domains[depth].empty()) {
-                    // Backtrack immediately if no options for next variable
-                }
+    void workerLoop() {
+        while (true) {
+            shared_ptr<ScheduleJob> job;
+            {
+                unique_lock<mutex> guard(queueMutex);
+                queueReady.wait(guard, [this]() { return stopping || !pending.empty(); });
+                if (stopping) return;
+                job = pending.top();
+                pending.pop();
+                lock_guard<mutex> jobGuard(job->lock);
+                if (job->status != JobStatus::Queued) continue; // Cancelled while waiting
+                job->status = JobStatus::Running;
+                job->startedAt = chrono::steady_clock::now();
+                queuedCount--;
             }
-        }
-        else {
-            // Save error for diagnostics if we fail at root
-            if (depth == 0) {
-                lastError = "Unable to schedule " + getCourse[variables[depth].courseID].courseName + " (Root)";
+
+            json result;
+            int status = 500;
+            try {
+                result = run(*job, status);
             }
-            else if (lastError == "") {
-                lastError = "Unable to schedule " + getCourse[variables[depth].courseID].courseName + " at depth " + to_string(depth);
+            catch (const exception& e) {
+                result = json::object();
+                result["success"] = false;
+                result["error"] = string("Server error: ") + e.what();
+                status = 500;
             }
 
-            domains[depth].clear(); // Free memory
-            depth--;
-
-            if (depth >= 0) {
-                CSPValue& prevVal = domains[depth][domainIndices[depth]];
-                undoMove(variables[depth], prevVal);
-            }
+            lock_guard<mutex> guard(queueMutex);
+            lock_guard<mutex> jobGuard(job->lock);
+            bool solved = result.value("success", false);
+            job->status = solved ? JobStatus::Succeeded : (job->cancel ? JobStatus::Cancelled : JobStatus::Failed);
+            job->result = move(result);
+            job->resultStatus = status;
+            job->finishedAt = chrono::steady_clock::now();
+            job->model = ProblemModel(); // The request is no longer needed
+            job->options = json();
+            retire(job->id);
         }
     }
 
-    return (depth == n);
-}
-
-// --- Management Functions ---
+    // Caller holds queueMutex
+    void retire(const string& id) {
+        finishedOrder.push_back(id);
+        while (finishedOrder.size() > MAX_FINISHED_JOBS) {
+            jobs.erase(finishedOrder.front());
+            finishedOrder.pop_front();
+        }
+    }
 
-void clearGlobalData() {
-    courses.clear();
-    instructors.clear();
-    tas.clear();
-    rooms.clear();
-    sections.clear();
-    getCourse.clear();
-    sectionToIndex.clear();
-    groupToSectionIndices.clear();
-    yearToSectionIndices.clear();
+    size_t capacity;
+    Runner run;
+    mt19937_64 idGenerator;
+    vector<thread> threads;
+    mutex queueMutex;
+    condition_variable queueReady;
+    priority_queue<shared_ptr<ScheduleJob>, vector<shared_ptr<ScheduleJob>>, JobOrder> pending;
+    unordered_map<string, shared_ptr<ScheduleJob>> jobs;
+    deque<string> finishedOrder;
+    size_t queuedCount = 0;
+    uint64_t nextSequence = 0;
+    bool stopping = false;
+};
 
-    Timetable.clear();
-    sectionScheduledCourses.clear();
+// Server-wide settings, overridable on the command line
+struct ServerConfig {
+    int httpThreads = max(4u, thread::hardware_concurrency()); // Concurrent requests being handled
+    int solverThreads = max(1u, thread::hardware_concurrency()); // Size of the shared solver pool
+    int portfolioThreads = 1; // Default concurrent instances per request (1 = serial retries)
+    int jobWorkers = 2;           // Asynchronous jobs solved at once
+    int jobQueueCapacity = 64;    // Queued jobs beyond this are refused with 503
+    size_t cacheBytes = 64 << 20; // Solution cache budget, 0 disables it
+    string cacheDirectory;        // Optional on-disk store for cached solutions
+    int batchWorkers = max(1u, thread::hardware_concurrency()); // Batch scenarios solved at once, over all requests
+    string tracePath;             // Search trace ring file, written by every solve when set
+    uint64_t traceRecords = 1 << 20; // Ring capacity, 20 bytes per record
+};
 
-    for (int i = 0; i < SLOTS_MAX; i++) {
-        instructorBusy[i].clear();
-        roomBusy[i].clear();
+ServerConfig parseServerConfig(int argc, char** argv) {
+    ServerConfig config;
+    for (int i = 1; i + 1 < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--http-threads") config.httpThreads = max(1, atoi(argv[++i]));
+        else if (arg == "--solver-threads") config.solverThreads = max(1, atoi(argv[++i]));
+        else if (arg == "--portfolio-threads") config.portfolioThreads = max(1, atoi(argv[++i]));
+        else if (arg == "--job-workers") config.jobWorkers = max(1, atoi(argv[++i]));
+        else if (arg == "--job-queue-capacity") config.jobQueueCapacity = max(1, atoi(argv[++i]));
+        else if (arg == "--cache-bytes") config.cacheBytes = strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--cache-dir") config.cacheDirectory = argv[++i];
+        else if (arg == "--batch-workers") config.batchWorkers = max(1, atoi(argv[++i]));
+        else if (arg == "--trace") config.tracePath = argv[++i];
+        else if (arg == "--trace-records") config.traceRecords = max(1ULL, strtoull(argv[++i], nullptr, 10));
     }
+    return config;
 }
 
-// Resets only the scheduling state, keeps inputs (Courses, Sections, etc.)
-void resetSimulationState() {
-    Timetable.assign(SLOTS_MAX, vector<Slot>(SECTIONS_MAX, Slot()));
-    sectionScheduledCourses.assign(SECTIONS_MAX, unordered_set<string>());
-
-    for (int i = 0; i < SLOTS_MAX; i++) {
-        instructorBusy[i].clear();
-        roomBusy[i].clear();
+int main(int argc, char** argv) {
+    Server svr;
+    ServerConfig config = parseServerConfig(argc, argv);
+    WorkerPool solverPool(config.solverThreads);
+
+    SearchTrace searchTrace;
+    if (!config.tracePath.empty()) {
+        string traceError;
+        if (searchTrace.open(config.tracePath, config.traceRecords, traceError)) cout << "Tracing the search to " << config.tracePath << endl;
+        else cout << "Search trace disabled: " << traceError << endl;
     }
+    auto newControl = [&searchTrace]() {
+        SolveControl control;
+        if (searchTrace.isOpen()) control.trace = &searchTrace;
+        return control;
+    };
+
+    // Every request owns its model and solver state, so handlers run fully in parallel
+    svr.new_task_queue = [&config]() { return new ThreadPool(config.httpThreads); };
+
+    SolutionCache solutionCache(config.cacheBytes, config.cacheDirectory);
+    ServerMetrics metrics;
+    JobQueue jobQueue(config.jobWorkers, config.jobQueueCapacity, [&](ScheduleJob& job, int& status) {
+        SolveControl control = newControl();
+        control.abortFlag = &job.cancel;
+        control.progress = &job.progress;
+        RequestStats stats;
+        stats.phases.parse = job.parseMs;
+        stats.phases.queueWait = chrono::duration<double, milli>(job.startedAt - job.submittedAt).count();
+        metrics.recordQueueWait(stats.phases.queueWait);
+        ActiveSolve active(metrics.activeSolves);
+        ScheduleResponse response = runScheduleRequest(job.model, job.options, solverPool, config.portfolioThreads, control, stats, status, &solutionCache);
+        auto phaseStart = chrono::steady_clock::now();
+        json result = response.toJson(); // Kept for status polls, encoded per request
+        stats.phases.serialize += elapsedMs(phaseStart);
+        metrics.record(stats);
+        return result;
+    });
+
+    WorkerPool scenarioPool(config.batchWorkers);
+
+    svr.Post("/api/schedule", [&](const Request& req, Response& res) {
+        try {
+            // Byte-identical reposts skip parsing altogether
+            auto requestStart = chrono::steady_clock::now();
+            string rawKey = solutionCache.enabled() ? fingerprint(req.body) : "";
+            string cached;
+            RequestStats stats;
+            WireFormat format = negotiateFormat(req);
+            if (solutionCache.lookupRaw(rawKey, cached)) {
+                json body = json::parse(cached);
+                body["diagnostics"] = cacheHitDiagnostics(requestStart);
+                sendBody(req, res, encodeJson(body, format), format);
+                res.set_header("Access-Control-Allow-Origin", "*");
+                res.set_header("X-Cache", "hit");
+                res.status = 200;
+                stats.result = "cached";
+                metrics.record(stats);
+                return;
+            }
 
-    lastError = "";
-    iterationCount = 0;
-}
-
-void parseInputData(const json& inputData) {
-    clearGlobalData();
-
-    if (inputData.contains("courses")) {
-        for (auto c : inputData["courses"]) {
-            Course course;
-            course.courseID = c.value("courseID", "");
-            course.courseName = c.value("courseName", "");
-            string type = c.value("type", "");
-            if (type == "lec" || type == "Lec" || type == "lecture") course.type = "Lecture";
-            else if (type == "tut" || type == "Tut" || type == "tutorial") course.type = "Tutorial";
-            else if (type == "lab" || type == "Lab") course.type = "Lab";
-            else course.type = type;
-
-            course.labType = c.value("labType", "");
-            course.allYear = c.value("allYear", false);
-            course.duration = c.value("duration", 1);
-            courses.push_back(course);
-            getCourse[course.courseID] = course;
-        }
-    }
-
-    if (inputData.contains("instructors")) {
-        for (auto i : inputData["instructors"]) {
-            Instructor instructor;
-            instructor.instructorID = i.value("instructorID", "");
-            instructor.name = i.value("name", "");
-            if (i.contains("qualifiedCourses")) instructor.qualifiedCourses = i["qualifiedCourses"].get<vector<string>>();
-            if (i.contains("unavailableTimeSlots")) instructor.unavailableTimeSlots = i["unavailableTimeSlots"].get<vector<int>>();
-            instructors.push_back(instructor);
-        }
-    }
-
-    if (inputData.contains("tas")) {
-        for (auto t : inputData["tas"]) {
-            TA ta;
-            ta.taID = t.value("taID", "");
-            ta.name = t.value("name", "");
-            if (t.contains("qualifiedCourses")) ta.qualifiedCourses = t["qualifiedCourses"].get<vector<string>>();
-            if (t.contains("unavailableTimeSlots")) ta.unavailableTimeSlots = t["unavailableTimeSlots"].get<vector<int>>();
-            tas.push_back(ta);
-        }
-    }
-
-    if (inputData.contains("rooms")) {
-        for (auto r : inputData["rooms"]) {
-            Room room;
-            room.roomID = r.value("roomID", "");
-            string type = r.value("type", "");
-            if (type == "lec" || type == "lecture") room.type = "Lecture";
-            else if (type == "tut" || type == "tutorial") room.type = "Tutorial";
-            else if (type == "lab" || type == "Lab") room.type = "Lab";
-            else room.type = type;
-
-            room.labType = r.value("labType", "");
-            room.capacity = r.value("capacity", 0);
-            rooms.push_back(room);
-        }
-    }
-
-    if (inputData.contains("sections")) {
-        int idx = 0;
-        for (auto s : inputData["sections"]) {
-            Section section;
-            section.sectionID = s.value("sectionID", "");
-            section.groupID = s.value("groupID", "");
-            section.year = s.value("year", 1);
-            section.studentCount = s.value("studentCount", 0);
-            if (s.contains("assignedCourses")) section.assignedCourses = s["assignedCourses"].get<vector<string>>();
-            else if (s.contains("courses")) section.assignedCourses = s["courses"].get<vector<string>>();
-
-            sections.push_back(section);
-            sectionToIndex[section.sectionID] = idx;
-            groupToSectionIndices[section.groupID].push_back(idx);
-            yearToSectionIndices[section.year].push_back(idx); // Populate Year Map
-            idx++;
-        }
-    }
-
-    SECTIONS_MAX = sections.size();
-    // Resize is handled in resetSimulationState, but good to init here
-    Timetable.resize(SLOTS_MAX, vector<Slot>(SECTIONS_MAX, Slot()));
-    sectionScheduledCourses.resize(SECTIONS_MAX);
-}
-
-json timetableToJson() {
-    json result;
-    result["success"] = true;
-    result["slotsMax"] = SLOTS_MAX;
-
-    json sectionsSchedule = json::array();
-
-    for (size_t j = 0; j < sections.size(); j++) {
-        json sectionData;
-        sectionData["sectionID"] = sections[j].sectionID;
-        sectionData["groupID"] = sections[j].groupID;
-        sectionData["year"] = sections[j].year;
-
-        json schedule = json::array();
-
-        for (int i = 0; i < SLOTS_MAX; i++) {
-            if (Timetable[i][j].istaken && !Timetable[i][j].isCont) {
-                json slot;
-                slot["slotIndex"] = i;
-                slot["courseID"] = Timetable[i][j].courseID;
-                slot["courseName"] = getCourse[Timetable[i][j].courseID].courseName;
-                slot["type"] = Timetable[i][j].type;
-                slot["roomID"] = Timetable[i][j].roomID;
-                slot["instructorID"] = Timetable[i][j].instructorID;
-                slot["instructorName"] = getInstructorName(Timetable[i][j].instructorID);
-                slot["duration"] = Timetable[i][j].duration;
-
-                if (Timetable[i][j].duration > 1) {
-                    slot["slotRange"] = to_string(i) + "-" + to_string(i + Timetable[i][j].duration - 1);
-                }
-                else {
-                    slot["slotRange"] = to_string(i);
-                }
-                schedule.push_back(slot);
+            auto phaseStart = chrono::steady_clock::now();
+            ProblemModel model; // Private to this request
+            json options;
+            string parseError;
+            if (!parseInputStream(req.body, model, options, parseError)) {
+                sendJson(req, res, invalidBodyResponse(parseError));
+                res.set_header("Access-Control-Allow-Origin", "*");
+                res.status = 400;
+                stats.result = "invalid";
+                metrics.record(stats);
+                return;
             }
+            stats.phases.parse = elapsedMs(phaseStart);
+            int status = 500;
+            ActiveSolve active(metrics.activeSolves);
+            ScheduleResponse response = runScheduleRequest(model, options, solverPool, config.portfolioThreads, newControl(), stats, status, &solutionCache, rawKey);
+            phaseStart = chrono::steady_clock::now();
+            sendBody(req, res, response.encode(format), format);
+            stats.phases.serialize += elapsedMs(phaseStart);
+            metrics.record(stats);
+            res.set_header("Access-Control-Allow-Origin", "*");
+            if (response.body["diagnostics"].contains("cache")) res.set_header("X-Cache", response.body["diagnostics"]["cache"].get<string>());
+            res.status = status;
         }
-        sectionData["schedule"] = schedule;
-        sectionsSchedule.push_back(sectionData);
-    }
-
-    result["sections"] = sectionsSchedule;
-    return result;
-}
+        catch (const exception& e) {
+            json errorResponse;
+            errorResponse["success"] = false;
+            errorResponse["error"] = string("Server error: ") + e.what();
+            sendJson(req, res, errorResponse);
+            res.status = 500;
+        }
+        });
 
-int main() {
-    Server svr;
+    svr.Post("/api/schedule/resolve", [&](const Request& req, Response& res) {
+        try {
+            RequestStats stats;
+            auto phaseStart = chrono::steady_clock::now();
+            json body = json::parse(req.body);
+            stats.phases.parse = elapsedMs(phaseStart);
+            int status = 500;
+            ActiveSolve active(metrics.activeSolves);
+            ProblemModel model;
+            ScheduleResponse response = runResolveRequest(body, model, newControl(), stats, status);
+            phaseStart = chrono::steady_clock::now();
+            WireFormat format = negotiateFormat(req);
+            sendBody(req, res, response.encode(format), format);
+            stats.phases.serialize += elapsedMs(phaseStart);
+            metrics.record(stats);
+            res.set_header("Access-Control-Allow-Origin", "*");
+            res.status = status;
+        }
+        catch (const exception& e) {
+            json errorResponse;
+            errorResponse["success"] = false;
+            errorResponse["error"] = string("Server error: ") + e.what();
+            sendJson(req, res, errorResponse);
+            res.status = 500;
+        }
+        });
 
-    svr.Post("/api/schedule", [](const Request& req, Response& res) {
+    // What-if batches: a full /api/schedule body plus "scenarios": [{ "id", "delta", "options" }].
+    // The base is parsed and compiled once and every scenario overlays it; scenarios are solved
+    // on the scenario pool, one solver thread each unless their options ask for more, and stream
+    // back as NDJSON lines in the order they finish, followed by a summary line.
+    svr.Post("/api/schedule/batch", [&](const Request& req, Response& res) {
+        res.set_header("Access-Control-Allow-Origin", "*");
         try {
-            json inputData = json::parse(req.body);
-            parseInputData(inputData);
-
-            // 1. Validate Input
-            vector<string> validationErrors = validateInput();
-            if (!validationErrors.empty()) {
-                json errResponse;
-                errResponse["success"] = false;
-                errResponse["error"] = "Input validation failed";
-                errResponse["details"] = validationErrors;
-                res.set_content(errResponse.dump(2), "application/json");
+            auto batch = make_shared<ScenarioBatch>();
+            batch->start = chrono::steady_clock::now();
+            ProblemModel model;
+            string parseError;
+            if (!parseInputStream(req.body, model, batch->options, parseError)) {
+                sendJson(req, res, invalidBodyResponse(parseError));
                 res.status = 400;
-                cout << "Validation Failed: " << validationErrors.size() << " errors found." << endl;
                 return;
             }
-
-            startTime = chrono::steady_clock::now();
-            resetSimulationState();
-
-            // 2. Identify Variables
-            vector<CSPVariable> variables = identifyVariables();
-
-            cout << "Starting CSP Solver..." << endl;
-            cout << "Variables to schedule: " << variables.size() << endl;
-
-            // 3. Initial Heuristic Sort (Most Constrained First)
-            // Sort priority: Hard Constraints > Longest Duration > Largest Student Count > Most Sections
-            sort(variables.begin(), variables.end(), [](const CSPVariable& a, const CSPVariable& b) {
-                if (a.isHardConstraint != b.isHardConstraint) return a.isHardConstraint > b.isHardConstraint;
-                if (a.duration != b.duration) return a.duration > b.duration;
-                if (a.totalStudents != b.totalStudents) return a.totalStudents > b.totalStudents;
-                return a.targetSectionIndices.size() > b.targetSectionIndices.size();
-                });
-
-            // 4. Attempt to Solve (Initial Attempt)
-            bool success = solveIterative(variables);
-
-            // 5. Retry Logic with Random Shuffling if failed
-            int attempts = 0;
-            std::random_device rd;
-            std::mt19937 g(rd());
-
-            while (!success && attempts < MAX_RETRIES) {
-                cout << "Solution attempt " << (attempts + 1) << " failed. Shuffling variables and retrying..." << endl;
-
-                resetSimulationState(); // Clear the board
-
-                // Shuffle the order of variables to escape local optima or bad search trees
-                // We keep Hard Constraints at the front to ensure critical items get slots, 
-                // but shuffle the rest, or shuffle everything if necessary.
-                // Here we perform a full shuffle for maximum variation as requested.
-                std::shuffle(variables.begin(), variables.end(), g);
-
-                startTime = chrono::steady_clock::now(); // Reset timer for the new attempt
-                success = solveIterative(variables);
-                attempts++;
+            json scenarios = batch->options.value("scenarios", json());
+            batch->options.erase("scenarios");
+            bool wellFormed = scenarios.is_array() && !scenarios.empty() && scenarios.size() <= MAX_BATCH_SCENARIOS;
+            bool rebuilds = false;
+            for (size_t i = 0; wellFormed && i < scenarios.size(); i++) {
+                wellFormed = scenarios[i].is_object();
+                json delta = wellFormed ? scenarios[i].value("delta", json::object()) : json();
+                string deltaError; // Reported on the scenario's own line
+                if (wellFormed && checkInputDelta(delta, deltaError)) rebuilds |= !isVariantDelta(delta);
             }
-
-            auto endTime = chrono::steady_clock::now();
-            auto duration = chrono::duration_cast<chrono::milliseconds>(endTime - startTime).count();
-
-            json response;
-            if (success) {
-                response = timetableToJson();
-                cout << "SUCCESS: Timetable generated in " << duration << "ms (Attempts: " << attempts + 1 << ")" << endl;
+            if (!wellFormed) {
+                sendJson(req, res, invalidBodyResponse("\"scenarios\" must be an array of 1 to " + to_string(MAX_BATCH_SCENARIOS) + " objects"));
+                res.status = 400;
+                return;
             }
-            else {
-                response["success"] = false;
-                response["error"] = lastError.empty() ? "No valid solution found after multiple attempts." : lastError;
-                response["iterations"] = iterationCount;
-                response["attempts"] = attempts + 1;
-                cout << "FAILED: " << lastError << endl;
+            if (rebuilds) {
+                batch->baseData = json::parse(req.body);
+                batch->baseData.erase("scenarios");
             }
 
-            response["diagnostics"]["timeTakenMs"] = duration;
-            response["diagnostics"]["totalAttempts"] = attempts + 1;
-
-            res.set_content(response.dump(2), "application/json");
-            res.set_header("Access-Control-Allow-Origin", "*");
-            res.status = success ? 200 : 400;
+            vector<CSPVariable> variables;
+            applyObjectiveWeights(batch->options, model.weights);
+            compileUnchecked(model, variables);
+            if (solutionCache.enabled()) batch->baseCanonical = canonicalProblem(model, json::object());
+            batch->base = { make_shared<const ProblemModel>(move(model)), make_shared<const vector<CSPVariable>>(move(variables)) };
+            batch->pending = scenarios.size();
+            cout << "Batch of " << scenarios.size() << " scenarios" << endl;
+
+            for (size_t i = 0; i < scenarios.size(); i++) {
+                scenarioPool.submit([&, batch, i, scenario = move(scenarios[i])]() {
+                    string line;
+                    int status = 0;
+                    if (!batch->cancel) {
+                        SolveControl control = newControl();
+                        control.abortFlag = &batch->cancel;
+                        RequestStats stats;
+                        ActiveSolve active(metrics.activeSolves);
+                        // Every scenario ends in a line, or the stream would wait on it forever
+                        try {
+                            line = runScenario(*batch, i, scenario, solverPool, control, stats, status, &solutionCache);
+                        }
+                        catch (const json::exception& e) {
+                            status = 400;
+                            stats.result = "invalid";
+                            line = scenarioLine(i, scenario, status, invalidScenarioResponse(e.what()).dump());
+                        }
+                        catch (const exception& e) {
+                            status = 500;
+                            stats.result = "failed";
+                            line = scenarioLine(i, scenario, status, json({ {"success", false}, {"error", string("Server error: ") + e.what()} }).dump());
+                        }
+                        metrics.record(stats);
+                    }
+                    lock_guard<mutex> lock(batch->linesMutex);
+                    if (status == 200) batch->succeeded++;
+                    if (!line.empty()) batch->lines.push_back(move(line));
+                    batch->pending--;
+                    batch->linesReady.notify_all();
+                });
+            }
 
+            size_t total = batch->pending;
+            res.set_chunked_content_provider("application/x-ndjson", [batch, total](size_t, DataSink& sink) {
+                unique_lock<mutex> lock(batch->linesMutex);
+                while (true) {
+                    batch->linesReady.wait(lock, [&]() { return !batch->lines.empty() || batch->pending == 0; });
+                    while (!batch->lines.empty()) {
+                        string line = move(batch->lines.front());
+                        batch->lines.pop_front();
+                        lock.unlock();
+                        bool sent = sink.write(line.data(), line.size());
+                        lock.lock();
+                        if (!sent) {
+                            batch->cancel = true; // Scenarios not started yet are skipped, running ones abort
+                            return false;
+                        }
+                    }
+                    if (batch->pending == 0) break;
+                }
+                json summary = { {"done", true}, {"scenarios", total}, {"succeeded", batch->succeeded}, {"timeTakenMs", elapsedMs(batch->start)} };
+                lock.unlock();
+                string line = summary.dump() + "\n";
+                sink.write(line.data(), line.size());
+                sink.done();
+                return true;
+                }, [batch](bool success) { if (!success) batch->cancel = true; });
+            res.status = 200;
+        }
+        catch (const json::exception& e) {
+            // Malformed options, such as objective weights of the wrong type
+            sendJson(req, res, invalidBodyResponse(e.what()));
+            res.status = 400;
+            RequestStats stats;
+            stats.result = "invalid";
+            metrics.record(stats);
         }
         catch (const exception& e) {
             json errorResponse;
             errorResponse["success"] = false;
             errorResponse["error"] = string("Server error: ") + e.what();
-            res.set_content(errorResponse.dump(), "application/json");
+            sendJson(req, res, errorResponse);
             res.status = 500;
+            RequestStats stats;
+            stats.result = "failed";
+            metrics.record(stats);
+        }
+        });
+
+    // Asynchronous jobs: submit returns at once, then the client polls status or cancels
+    svr.Post("/api/schedule/jobs", [&](const Request& req, Response& res) {
+        res.set_header("Access-Control-Allow-Origin", "*");
+        ProblemModel model;
+        json options;
+        string parseError;
+        auto parseStart = chrono::steady_clock::now();
+        if (!parseInputStream(req.body, model, options, parseError)) {
+            sendJson(req, res, invalidBodyResponse(parseError));
+            res.status = 400;
+            return;
+        }
+        json priorityOption = options.value("priority", json(0));
+        if (!priorityOption.is_number_integer()) {
+            sendJson(req, res, invalidBodyResponse("$.priority: expected an integer"));
+            res.status = 400;
+            return;
+        }
+        int priority = priorityOption.get<int>();
+        shared_ptr<ScheduleJob> job = jobQueue.submit(move(model), move(options), priority, elapsedMs(parseStart));
+        if (!job) {
+            json errorResponse;
+            errorResponse["success"] = false;
+            errorResponse["error"] = "Job queue is full, try again later.";
+            sendJson(req, res, errorResponse);
+            res.set_header("Retry-After", "5");
+            res.status = 503;
+            return;
         }
+        cout << "Queued " << job->id << " (priority " << priority << ")" << endl;
+        res.set_header("Location", "/api/schedule/jobs/" + job->id);
+        sendJson(req, res, jobToJson(*job));
+        res.status = 202;
         });
 
+    svr.Get("/api/schedule/jobs/([A-Za-z0-9-]+)", [&](const Request& req, Response& res) {
+        res.set_header("Access-Control-Allow-Origin", "*");
+        shared_ptr<ScheduleJob> job = jobQueue.find(req.matches[1]);
+        if (!job) {
+            sendJson(req, res, { {"success", false}, {"error", "Unknown job"} });
+            res.status = 404;
+            return;
+        }
+        sendJson(req, res, jobToJson(*job));
+        res.status = 200;
+        });
 
-    svr.Options("/api/schedule", [](const Request& req, Response& res) {
+    svr.Delete("/api/schedule/jobs/([A-Za-z0-9-]+)", [&](const Request& req, Response& res) {
+        res.set_header("Access-Control-Allow-Origin", "*");
+        shared_ptr<ScheduleJob> job = jobQueue.find(req.matches[1]);
+        if (!job) {
+            sendJson(req, res, { {"success", false}, {"error", "Unknown job"} });
+            res.status = 404;
+            return;
+        }
+        JobStatus previous = jobQueue.cancel(job);
+        if (previous != JobStatus::Queued && previous != JobStatus::Running) {
+            sendJson(req, res, { {"success", false}, {"error", "Job already finished"} });
+            res.status = 409;
+            return;
+        }
+        cout << "Cancelling " << job->id << endl;
+        sendJson(req, res, jobToJson(*job));
+        res.status = previous == JobStatus::Running ? 202 : 200;
+        });
+
+    svr.Get("/api/cache/stats", [&](const Request& req, Response& res) {
+        res.set_header("Access-Control-Allow-Origin", "*");
+        sendJson(req, res, solutionCache.stats());
+        res.status = 200;
+        });
+
+    // Prometheus text format
+    svr.Get("/api/metrics", [&](const Request&, Response& res) {
+        res.set_content(metrics.prometheus(solutionCache.stats(), jobQueue.queued()), "text/plain; version=0.0.4");
+        res.status = 200;
+        });
+
+    svr.Options("/api/schedule(/resolve|/batch)?", [](const Request&, Response& res) {
         res.set_header("Access-Control-Allow-Origin", "*");
         res.set_header("Access-Control-Allow-Methods", "POST, OPTIONS");
         res.set_header("Access-Control-Allow-Headers", "Content-Type");
         res.status = 204;
         });
 
+    svr.Options("/api/schedule/jobs(/[A-Za-z0-9-]+)?", [](const Request&, Response& res) {
+        res.set_header("Access-Control-Allow-Origin", "*");
+        res.set_header("Access-Control-Allow-Methods", "GET, POST, DELETE, OPTIONS");
+        res.set_header("Access-Control-Allow-Headers", "Content-Type");
+        res.status = 204;
+        });
+
     cout << "CSP Timetable Server running at http://0.0.0.0:8080" << endl;
     if (!svr.listen("0.0.0.0", 8080)) {
         cerr << "Error: Could not start server on port 8080." << endl;
@@ -0,0 +1,144 @@
+#include "instance_generator.h"
+#include "solver.h"
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+const double STAFF_LOAD = 0.5; // Share of the week each generated lecturer or TA is expected to teach
+
+// k distinct values of [0, n) in ascending order. Only raw mt19937 output is used, whose sequence
+// the standard fixes, so instances do not depend on the standard library's distributions.
+vector<int> sample(mt19937& rng, int n, int k) {
+    vector<int> all(n);
+    for (int i = 0; i < n; i++) all[i] = i;
+    k = min(k, n);
+    for (int i = 0; i < k; i++) swap(all[i], all[i + rng() % (n - i)]);
+    all.resize(k);
+    sort(all.begin(), all.end());
+    return all;
+}
+
+int poolSize(int demandSlots, int weekSlots, double utilization) {
+    return max(1, (int)ceil(demandSlots / (weekSlots * utilization)));
+}
+
+// Staff pool sized for the teaching load; each course gets `density` of the pool as qualified staff
+json generateStaff(mt19937& rng, const vector<string>& courseIDs, int demandSlots, int weekSlots, double density,
+                   const string& idPrefix, const string& idKey, const string& namePrefix) {
+    int pool = max(2, poolSize(demandSlots, weekSlots, STAFF_LOAD));
+    int perCourse = max(1, (int)lround(density * pool));
+    vector<vector<string>> qualified(pool);
+    for (const string& cID : courseIDs) {
+        for (int s : sample(rng, pool, perCourse)) qualified[s].push_back(cID);
+    }
+
+    json staff = json::array();
+    for (int s = 0; s < pool; s++) {
+        staff.push_back({
+            { idKey, idPrefix + to_string(s) },
+            { "name", namePrefix + " " + to_string(s) },
+            { "qualifiedCourses", qualified[s] },
+            { "unavailableTimeSlots", sample(rng, weekSlots, 2) },
+            { "preferredTimeSlots", sample(rng, weekSlots, 6) },
+        });
+    }
+    return staff;
+}
+
+void addRooms(json& rooms, const string& prefix, const string& type, const string& labType, int count, int capacity) {
+    for (int r = 0; r < count; r++) {
+        json room = { { "roomID", prefix + to_string(r) }, { "type", type }, { "capacity", capacity } };
+        if (!labType.empty()) room["labType"] = labType;
+        rooms.push_back(room);
+    }
+}
+
+} // namespace
+
+json instanceParamsToJson(const InstanceParams& p) {
+    return {
+        { "years", p.years },
+        { "groupsPerYear", p.groupsPerYear },
+        { "sectionsPerGroup", p.sectionsPerGroup },
+        { "coursesPerYear", p.coursesPerYear },
+        { "labsPerYear", p.labsPerYear },
+        { "studentsPerSection", p.studentsPerSection },
+        { "allYearRatio", p.allYearRatio },
+        { "qualificationDensity", p.qualificationDensity },
+        { "roomScarcity", p.roomScarcity },
+        { "days", p.days },
+        { "periodsPerDay", p.periodsPerDay },
+        { "seed", p.seed },
+    };
+}
+
+json generateInstance(const InstanceParams& p) {
+    mt19937 rng(p.seed);
+    int sectionsPerYear = p.groupsPerYear * p.sectionsPerGroup;
+    int allYearCourses = (int)lround(p.allYearRatio * p.coursesPerYear);
+    double utilization = min(1.0, max(0.05, p.roomScarcity));
+    int weekSlots = p.days * p.periodsPerDay;
+
+    json courses = json::array(), sections = json::array(), rooms = json::array();
+    vector<string> lectureIDs, assistedIDs; // Lectures go to lecturers, tutorials and labs to TAs
+    int lectureSlots = 0, tutorialSlots = 0, labSlots[2] = { 0, 0 };
+
+    for (int y = 1; y <= p.years; y++) {
+        vector<string> yearCourses;
+        for (int k = 0; k < p.coursesPerYear; k++) {
+            string id = "Y" + to_string(y) + "C" + to_string(k);
+            bool allYear = k < allYearCourses;
+            courses.push_back({ { "courseID", id + "L" }, { "courseName", "Lecture " + to_string(y) + "-" + to_string(k) },
+                                { "type", "lec" }, { "duration", 2 }, { "allYear", allYear } });
+            courses.push_back({ { "courseID", id + "T" }, { "courseName", "Tutorial " + to_string(y) + "-" + to_string(k) },
+                                { "type", "tut" }, { "duration", 1 } });
+            lectureIDs.push_back(id + "L");
+            assistedIDs.push_back(id + "T");
+            yearCourses.push_back(id + "L");
+            yearCourses.push_back(id + "T");
+            lectureSlots += 2 * (allYear ? 1 : p.groupsPerYear);
+            tutorialSlots += sectionsPerYear;
+        }
+        for (int k = 0; k < p.labsPerYear; k++) {
+            string id = "Y" + to_string(y) + "B" + to_string(k);
+            courses.push_back({ { "courseID", id }, { "courseName", "Lab " + to_string(y) + "-" + to_string(k) },
+                                { "type", "lab" }, { "labType", k % 2 == 0 ? "pc" : "elec" }, { "duration", 2 } });
+            assistedIDs.push_back(id);
+            yearCourses.push_back(id);
+            labSlots[k % 2] += 2 * sectionsPerYear;
+        }
+
+        for (int g = 0; g < p.groupsPerYear; g++) {
+            for (int s = 0; s < p.sectionsPerGroup; s++) {
+                sections.push_back({
+                    { "sectionID", "S" + to_string(y) + "-" + to_string(g) + "-" + to_string(s) },
+                    { "groupID", "G" + to_string(y) + "-" + to_string(g) },
+                    { "year", y },
+                    { "studentCount", p.studentsPerSection },
+                    { "assignedCourses", yearCourses },
+                });
+            }
+        }
+    }
+
+    // Room counts follow the demand of each kind, so roomScarcity is the utilization they run at
+    int hallCapacity = p.studentsPerSection * (allYearCourses > 0 ? sectionsPerYear : p.sectionsPerGroup);
+    addRooms(rooms, "H", "lec", "", poolSize(lectureSlots, weekSlots, utilization), hallCapacity);
+    addRooms(rooms, "R", "tut", "", poolSize(tutorialSlots, weekSlots, utilization), p.studentsPerSection);
+    if (labSlots[0]) addRooms(rooms, "P", "lab", "pc", poolSize(labSlots[0], weekSlots, utilization), p.studentsPerSection);
+    if (labSlots[1]) addRooms(rooms, "E", "lab", "elec", poolSize(labSlots[1], weekSlots, utilization), p.studentsPerSection);
+
+    json instance;
+    instance["grid"] = { { "days", p.days }, { "periodsPerDay", p.periodsPerDay } };
+    instance["courses"] = courses;
+    instance["instructors"] = generateStaff(rng, lectureIDs, lectureSlots, weekSlots, p.qualificationDensity, "I", "instructorID", "Lecturer");
+    instance["tas"] = generateStaff(rng, assistedIDs, tutorialSlots + labSlots[0] + labSlots[1], weekSlots, p.qualificationDensity, "T", "taID", "TA");
+    instance["rooms"] = rooms;
+    instance["sections"] = sections;
+    return instance;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+// Synthetic timetabling instances in the request format of POST /api/schedule.
+// The same parameters and seed always produce the same instance, on every platform.
+
+#include <nlohmann/json.hpp>
+
+struct InstanceParams {
+    int years = 2;
+    int groupsPerYear = 2;
+    int sectionsPerGroup = 3;
+    int coursesPerYear = 4;           // Each course is a two-slot lecture plus a one-slot tutorial
+    int labsPerYear = 2;              // Two-slot labs, alternating between "pc" and "elec" rooms
+    int studentsPerSection = 30;
+    double allYearRatio = 0.25;       // Share of lectures given to the whole year at once
+    double qualificationDensity = 0.3; // Share of the lecturer or TA pool qualified for each course
+    double roomScarcity = 0.5;        // Target weekly utilization of each room kind, 1 leaves no slack
+    int days = 5;                     // Week grid of the instance
+    int periodsPerDay = 8;
+    unsigned seed = 1;
+};
+
+nlohmann::json instanceParamsToJson(const InstanceParams& params);
+nlohmann::json generateInstance(const InstanceParams& params);
@@ -0,0 +1,307 @@
+// Solver benchmarks: microbenchmarks of the search hot paths on one synthetic instance, plus
+// end-to-end solveIterative scaling over growing instances and over week grids of every mask
+// width. Prints one JSON document so results can be stored per release and compared.
+//
+//   solver_bench [--quick] [--out FILE] [--seed N] [--max-iterations N] [--min-time-ms N]
+
+#include "instance_generator.h"
+#include "solver.h"
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+
+using namespace std;
+
+struct BenchConfig {
+    bool quick = false;            // Smaller scaling curve and shorter timing runs, for CI smoke runs
+    string outputPath;             // JSON goes to stdout when empty
+    unsigned seed = 1;
+    int maxIterations = 200000;    // Per end-to-end solve; unsolved runs are reported, not retried
+    long long minTimeMs = 200;     // Per timing repetition
+    int repetitions = 5;
+};
+
+BenchConfig parseBenchConfig(int argc, char** argv) {
+    BenchConfig config;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--quick") config.quick = true;
+        else if (i + 1 >= argc) break;
+        else if (arg == "--out") config.outputPath = argv[++i];
+        else if (arg == "--seed") config.seed = strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--max-iterations") config.maxIterations = max(1, atoi(argv[++i]));
+        else if (arg == "--min-time-ms") config.minTimeMs = max(1, atoi(argv[++i]));
+    }
+    if (config.quick) {
+        config.minTimeMs = min(config.minTimeMs, 20LL);
+        config.repetitions = 3;
+    }
+    return config;
+}
+
+// Keeps benchmarked results observable so the optimizer cannot drop the calls
+volatile long long benchSink = 0;
+
+double elapsedNs(chrono::steady_clock::time_point since) {
+    return (double)chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - since).count();
+}
+
+// Times `body`, which performs `opsPerCall` operations per call. The call count is doubled until
+// one repetition lasts minTimeMs; the median of the repetitions is reported as ns per operation.
+template <typename F>
+json measure(const BenchConfig& config, const string& name, long long opsPerCall, F body) {
+    long long calls = 1;
+    while (true) {
+        auto start = chrono::steady_clock::now();
+        for (long long c = 0; c < calls; c++) benchSink += body();
+        if (elapsedNs(start) >= config.minTimeMs * 1e6 || calls >= (1LL << 40)) break;
+        calls *= 2;
+    }
+
+    vector<double> nsPerOp;
+    for (int r = 0; r < config.repetitions; r++) {
+        auto start = chrono::steady_clock::now();
+        for (long long c = 0; c < calls; c++) benchSink += body();
+        nsPerOp.push_back(elapsedNs(start) / (calls * opsPerCall));
+    }
+    sort(nsPerOp.begin(), nsPerOp.end());
+
+    cerr << "  " << name << ": " << nsPerOp[nsPerOp.size() / 2] << " ns/op" << endl;
+    return {
+        { "name", name },
+        { "nsPerOp", nsPerOp[nsPerOp.size() / 2] },
+        { "minNsPerOp", nsPerOp.front() },
+        { "maxNsPerOp", nsPerOp.back() },
+        { "opsPerRepetition", calls * opsPerCall },
+        { "repetitions", config.repetitions },
+    };
+}
+
+// Solves the instance with the server's primary strategy and a fixed iteration budget
+template <class Mask>
+bool solveInstance(SolverState<Mask>& st, const ProblemModel& model, const vector<CSPVariable>& variables, int maxIterations) {
+    SolverStrategy strategy = portfolioStrategy(0, VariableOrdering::DomWdeg, 0, SolverEngine::Backtrack);
+    st.iterationLimit = maxIterations;
+    return runStrategy(st, model, variables, strategy, nullptr, SolveControl());
+}
+
+json runMicrobenchmarks(const BenchConfig& config) {
+    InstanceParams params;
+    params.groupsPerYear = 3;
+    params.seed = config.seed;
+    json instance = generateInstance(params);
+    string text = instance.dump();
+
+    ProblemModel model;
+    vector<CSPVariable> variables;
+    json error;
+    if (!buildProblem(instance, model, variables, error)) return { { "error", error } };
+
+    SolverState<uint64_t> st; // The default 5 x 8 week
+    if (!solveInstance(st, model, variables, config.maxIterations)) {
+        return { { "error", "Benchmark instance not solved: " + st.lastError } };
+    }
+    cerr << "Microbenchmarks (" << variables.size() << " variables)" << endl;
+
+    json results = json::array();
+    results.push_back(measure(config, "json.parse", 1, [&]() {
+        return (long long)json::parse(text).size();
+    }));
+    results.push_back(measure(config, "json.buildProblem", 1, [&]() {
+        ProblemModel parsed;
+        vector<CSPVariable> parsedVariables;
+        json parseError;
+        buildProblem(json::parse(text), parsed, parsedVariables, parseError);
+        return (long long)parsedVariables.size();
+    }));
+    results.push_back(measure(config, "json.parseInputStream", 1, [&]() {
+        ProblemModel parsed;
+        vector<CSPVariable> parsedVariables;
+        json options, parseError;
+        string streamError;
+        if (parseInputStream(text, parsed, options, streamError)) compileProblem(parsed, parsedVariables, parseError);
+        return (long long)parsedVariables.size();
+    }));
+    const pair<const char*, WireFormat> formats[] = {
+        { "json.serialize", WireFormat::Json }, { "cbor.serialize", WireFormat::Cbor }, { "msgpack.serialize", WireFormat::MsgPack },
+    };
+    for (auto& format : formats) {
+        auto encode = [&]() {
+            WireWriter writer(format.second);
+            writeTimetable(writer, st, json::object());
+            return (long long)writer.bytes().size();
+        };
+        json result = measure(config, format.first, 1, encode);
+        result["bytes"] = encode();
+        results.push_back(result);
+    }
+
+    // The remaining benchmarks run on a half-filled board: every other class is taken off
+    // the solved timetable, so checks see a realistic mix of free and busy resources.
+    int n = variables.size();
+    vector<int> removed;
+    for (int v = 0; v < n; v += 2) {
+        undoMove(st, variables[v], st.assignedValue[v]);
+        removed.push_back(v);
+    }
+
+    const int QUERIES = 4096;
+    mt19937 rng(config.seed);
+    struct Query { int var; CSPValue val; };
+    vector<Query> queries(QUERIES);
+    for (Query& q : queries) {
+        q.var = rng() % n;
+        const CSPVariable& var = variables[q.var];
+        q.val.startSlot = rng() % (model.grid.slots() - var.duration + 1);
+        q.val.staffIdx = var.candidateStaff[rng() % var.candidateStaff.size()];
+        q.val.roomIdx = var.candidateRooms.empty() ? -1 : var.candidateRooms[rng() % var.candidateRooms.size()];
+    }
+
+    results.push_back(measure(config, "isInstructorAvailable", QUERIES, [&]() {
+        long long hits = 0;
+        for (const Query& q : queries) hits += isInstructorAvailable(st, q.val.staffIdx, q.val.startSlot, variables[q.var].duration);
+        return hits;
+    }));
+    results.push_back(measure(config, "isValidMove", QUERIES, [&]() {
+        long long hits = 0;
+        for (const Query& q : queries) hits += isValidMove(st, variables[q.var], q.val);
+        return hits;
+    }));
+
+    vector<uint64_t> liveStarts(n);
+    for (int v : removed) liveStarts[v] = computeLiveStarts(st, variables[v]);
+    DomainCursor<uint64_t> cursor;
+    results.push_back(measure(config, "domainCursor", removed.size(), [&]() {
+        long long values = 0;
+        CSPValue val;
+        for (int v : removed) {
+            openDomain(st, variables[v], liveStarts[v], cursor);
+            while (nextValue(st, variables[v], cursor, val)) values++;
+        }
+        return values;
+    }));
+    results.push_back(measure(config, "applyMove+undoMove", removed.size(), [&]() {
+        for (int v : removed) {
+            applyMove(st, variables[v], st.assignedValue[v]);
+            undoMove(st, variables[v], st.assignedValue[v]);
+        }
+        return (long long)removed.size();
+    }));
+
+    return { { "instance", instanceParamsToJson(params) }, { "variables", n }, { "results", results } };
+}
+
+// Builds and solves one generated instance end to end, with the mask width its grid dispatches to
+json runSolvePoint(const BenchConfig& config, const InstanceParams& params) {
+    ProblemModel model;
+    vector<CSPVariable> variables;
+    json error;
+    auto buildStart = chrono::steady_clock::now();
+    if (!buildProblem(generateInstance(params), model, variables, error)) {
+        return { { "instance", instanceParamsToJson(params) }, { "error", error } };
+    }
+    double buildMs = elapsedNs(buildStart) / 1e6;
+
+    return withSlotMask(model.grid, [&](auto widthTag) -> json {
+        SolverState<decltype(widthTag)> st;
+        auto solveStart = chrono::steady_clock::now();
+        bool solved = solveInstance(st, model, variables, config.maxIterations);
+        double solveMs = elapsedNs(solveStart) / 1e6;
+
+        cerr << "  groups=" << params.groupsPerYear << " scarcity=" << params.roomScarcity << " grid=" << params.days << "x" << params.periodsPerDay
+             << ": " << variables.size() << " variables, " << (solved ? "solved" : "unsolved") << " in " << solveMs << " ms" << endl;
+        return {
+            { "instance", instanceParamsToJson(params) },
+            { "variables", variables.size() },
+            { "sections", model.sections.size() },
+            { "maskBits", 8 * sizeof(widthTag) },
+            { "solved", solved },
+            { "provedInfeasible", st.provedInfeasible },
+            { "iterations", st.iterationCount },
+            { "nodes", st.counters.nodes },
+            { "backtracks", st.counters.backtracks },
+            { "buildMs", buildMs },
+            { "solveMs", solveMs },
+            { "iterationsPerSecond", solveMs > 0 ? st.iterationCount / solveMs * 1000 : 0.0 },
+            { "error", solved ? "" : st.lastError },
+        };
+    });
+}
+
+// End-to-end solveIterative over instances growing in groups per year, at two room scarcities
+json runScaling(const BenchConfig& config) {
+    vector<int> groups = config.quick ? vector<int>{ 1, 2, 4 } : vector<int>{ 1, 2, 4, 8, 12, 16 };
+    vector<double> scarcities = { 0.5, 0.9 };
+    cerr << "Scaling" << endl;
+
+    json points = json::array();
+    for (double scarcity : scarcities) {
+        for (int g : groups) {
+            InstanceParams params;
+            params.groupsPerYear = g;
+            params.roomScarcity = scarcity;
+            params.seed = config.seed;
+            points.push_back(runSolvePoint(config, params));
+        }
+    }
+    return points;
+}
+
+// The same instance on week grids that run the 64-, 128- and 256-bit solvers
+json runGrids(const BenchConfig& config) {
+    const pair<int, int> grids[] = { { 5, 8 }, { 6, 10 }, { 5, 16 }, { 6, 24 } };
+    cerr << "Grids" << endl;
+
+    json points = json::array();
+    for (auto& grid : grids) {
+        InstanceParams params;
+        params.groupsPerYear = config.quick ? 2 : 4;
+        params.days = grid.first;
+        params.periodsPerDay = grid.second;
+        params.seed = config.seed;
+        points.push_back(runSolvePoint(config, params));
+    }
+    return points;
+}
+
+int main(int argc, char** argv) {
+    BenchConfig config = parseBenchConfig(argc, argv);
+
+    json report;
+    report["schema"] = 1;
+    report["config"] = {
+        { "quick", config.quick },
+        { "seed", config.seed },
+        { "maxIterations", config.maxIterations },
+        { "minTimeMs", config.minTimeMs },
+        { "repetitions", config.repetitions },
+    };
+#if defined(__clang__)
+    report["compiler"] = "clang " __clang_version__;
+#elif defined(__GNUC__)
+    report["compiler"] = "gcc " __VERSION__;
+#elif defined(_MSC_VER)
+    report["compiler"] = "msvc " + to_string(_MSC_VER);
+#endif
+#ifdef NDEBUG
+    report["assertions"] = false;
+#else
+    report["assertions"] = true;
+#endif
+    report["micro"] = runMicrobenchmarks(config);
+    report["scaling"] = runScaling(config);
+    report["grids"] = runGrids(config);
+
+    if (config.outputPath.empty()) {
+        cout << report.dump(2) << endl;
+    }
+    else {
+        ofstream out(config.outputPath);
+        out << report.dump(2) << endl;
+        if (!out) {
+            cerr << "Cannot write " << config.outputPath << endl;
+            return 1;
+        }
+    }
+    return report["micro"].contains("error") ? 1 : 0;
+}
@@ -0,0 +1,486 @@
+﻿#include "sat.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <sstream>
+
+using namespace std;
+
+const size_t AMO_PAIRWISE_LIMIT = 6;     // Larger at-most-one groups use the sequential counter
+const double SAT_VARIABLE_DECAY = 0.95;
+const float SAT_CLAUSE_DECAY = 0.999f;
+const int SAT_RESTART_CONFLICTS = 100;   // Unit of the Luby restart sequence
+const size_t SAT_MIN_LEARNTS = 5000;     // Learnt clauses kept before the first reduction
+
+// --- CNF Formulas ---
+
+void CnfFormula::addClause(initializer_list<int> clause) {
+    literals.insert(literals.end(), clause.begin(), clause.end());
+    literals.push_back(0);
+    clauses++;
+}
+
+void CnfFormula::addClause(const vector<int>& clause) {
+    literals.insert(literals.end(), clause.begin(), clause.end());
+    literals.push_back(0);
+    clauses++;
+}
+
+void CnfFormula::atMostOne(const vector<int>& group) {
+    if (group.size() <= AMO_PAIRWISE_LIMIT) {
+        for (size_t i = 0; i < group.size(); i++) {
+            for (size_t j = i + 1; j < group.size(); j++) addClause({ -group[i], -group[j] });
+        }
+        return;
+    }
+    // Sequential counter: `prev` holds once one of the literals before group[i] does
+    int prev = newVariable(true);
+    addClause({ -group[0], prev });
+    for (size_t i = 1; i + 1 < group.size(); i++) {
+        int next = newVariable(true);
+        addClause({ -group[i], next });
+        addClause({ -prev, next });
+        addClause({ -group[i], -prev });
+        prev = next;
+    }
+    addClause({ -group.back(), -prev });
+}
+
+void CnfFormula::exactlyOne(const vector<int>& group) {
+    addClause(group);
+    atMostOne(group);
+}
+
+void writeDimacs(ostream& out, const CnfFormula& formula, const string& comment) {
+    istringstream lines(comment);
+    string line;
+    while (getline(lines, line)) out << "c " << line << '\n';
+    out << "p cnf " << formula.variables << ' ' << formula.clauses << '\n';
+    for (int lit : formula.literals) out << lit << (lit == 0 ? '\n' : ' ');
+}
+
+// --- Solver ---
+
+const SatSolver::CRef SatSolver::NO_REASON;
+
+// Term i of the Luby sequence 1 1 2 1 1 2 4 1 1 2 ...
+long long lubyTerm(int i) {
+    long long size = 1;
+    int exponent = 0;
+    while (size < i + 1) {
+        exponent++;
+        size = 2 * size + 1;
+    }
+    while (size - 1 != i) {
+        size = (size - 1) >> 1;
+        exponent--;
+        i = i % size;
+    }
+    return 1LL << exponent;
+}
+
+SatSolver::SatSolver(const CnfFormula& formula, unsigned seed) {
+    int n = formula.variables;
+    watches.resize(2 * n);
+    assigns.assign(n, 0);
+    polarity.assign(n, 0);
+    level.assign(n, 0);
+    reason.assign(n, NO_REASON);
+    activity.assign(n, 0);
+    heapIndex.assign(n, -1);
+    seen.assign(n, 0);
+    levelStamp.assign(n + 1, 0);
+    if (seed) {
+        mt19937 rng(seed);
+        uniform_real_distribution<double> jitter(0, 1e-5);
+        for (double& a : activity) a = jitter(rng);
+    }
+    decision.resize(n);
+    for (int v = 0; v < n; v++) {
+        decision[v] = !formula.auxiliary[v];
+        heapInsert(v);
+    }
+
+    vector<Lit> clause;
+    for (int lit : formula.literals) {
+        if (lit != 0) {
+            clause.push_back(lit > 0 ? 2 * (lit - 1) : 2 * (-lit - 1) + 1);
+            continue;
+        }
+        addProblemClause(clause);
+        clause.clear();
+    }
+    maxLearnts = max(SAT_MIN_LEARNTS, problemClauses.size() / 3);
+}
+
+// Drops duplicate and false literals; a unit is assigned at once, an empty clause proves unsatisfiability
+void SatSolver::addProblemClause(vector<Lit>& clause) {
+    sort(clause.begin(), clause.end());
+    clause.erase(unique(clause.begin(), clause.end()), clause.end());
+    size_t kept = 0;
+    for (size_t i = 0; i < clause.size(); i++) {
+        if (i + 1 < clause.size() && clause[i + 1] == (clause[i] ^ 1)) return; // x or not x
+        int8_t v = litValue(clause[i]);
+        if (v > 0) return;
+        if (v == 0) clause[kept++] = clause[i];
+    }
+    clause.resize(kept);
+    if (clause.empty()) unsatisfiable = true;
+    else if (clause.size() == 1) enqueue(clause[0], NO_REASON);
+    else {
+        CRef c = allocate(clause, false, 0);
+        problemClauses.push_back(c);
+        attach(c);
+    }
+}
+
+SatSolver::CRef SatSolver::allocate(const vector<Lit>& lits, bool isLearnt, int lbd) {
+    CRef c = arena.size();
+    arena.push_back(lits.size());
+    arena.push_back((isLearnt ? 1 : 0) | (uint32_t)lbd << 1);
+    arena.push_back(0);
+    arena.insert(arena.end(), lits.begin(), lits.end());
+    return c;
+}
+
+void SatSolver::attach(CRef c) {
+    uint32_t* lits = literals(c);
+    watches[lits[0] ^ 1].push_back({ c, lits[1] });
+    watches[lits[1] ^ 1].push_back({ c, lits[0] });
+}
+
+void SatSolver::enqueue(Lit l, CRef from) {
+    int v = l >> 1;
+    assigns[v] = (l & 1) ? -1 : 1;
+    level[v] = decisionLevel();
+    reason[v] = from;
+    trail.push_back(l);
+}
+
+// Unit propagation over the two watched literals of each clause. Returns the falsified clause, if any.
+SatSolver::CRef SatSolver::propagate() {
+    CRef conflict = NO_REASON;
+    while (propagated < trail.size()) {
+        Lit p = trail[propagated++];
+        Lit falseLit = p ^ 1;
+        vector<Watcher>& ws = watches[p];
+        counters.propagations++;
+        size_t i = 0, j = 0, end = ws.size();
+        while (i < end) {
+            Watcher w = ws[i++];
+            if (litValue(w.blocker) > 0) {
+                ws[j++] = w;
+                continue;
+            }
+            uint32_t* lits = literals(w.clause);
+            if (lits[0] == falseLit) {
+                lits[0] = lits[1];
+                lits[1] = falseLit;
+            }
+            Lit first = lits[0];
+            Watcher kept = { w.clause, first };
+            if (first != w.blocker && litValue(first) > 0) {
+                ws[j++] = kept;
+                continue;
+            }
+
+            // Watch another literal that is not false, if there is one
+            uint32_t size = arena[w.clause];
+            bool moved = false;
+            for (uint32_t k = 2; k < size; k++) {
+                if (litValue(lits[k]) >= 0) {
+                    lits[1] = lits[k];
+                    lits[k] = falseLit;
+                    watches[lits[1] ^ 1].push_back(kept);
+                    moved = true;
+                    break;
+                }
+            }
+            if (moved) continue;
+
+            ws[j++] = kept;
+            if (litValue(first) < 0) {
+                conflict = w.clause;
+                propagated = trail.size();
+                while (i < end) ws[j++] = ws[i++];
+            }
+            else {
+                enqueue(first, w.clause);
+            }
+        }
+        ws.resize(j);
+    }
+    return conflict;
+}
+
+// Whether every other literal of l's reason is already in the learnt clause or fixed at level 0
+bool SatSolver::redundant(Lit l) {
+    CRef c = reason[l >> 1];
+    uint32_t* lits = literals(c);
+    for (uint32_t k = 1; k < arena[c]; k++) {
+        int v = lits[k] >> 1;
+        if (!seen[v] && level[v] > 0) return false;
+    }
+    return true;
+}
+
+// First-UIP conflict analysis: resolves the conflict with the reasons of the current level's
+// literals, newest first, until one literal of that level is left. The learnt clause has it
+// at [0] and a literal of the level to backtrack to at [1].
+void SatSolver::analyze(CRef conflict, int& backtrackLevel, int& lbd) {
+    learnt.assign(1, 0);
+    int pathCount = 0;
+    bool first = true;
+    Lit p = 0;
+    int index = trail.size() - 1;
+    CRef c = conflict;
+    do {
+        if (arena[c + 1] & 1) bumpClause(c);
+        uint32_t* lits = literals(c);
+        for (uint32_t k = first ? 0 : 1; k < arena[c]; k++) {
+            Lit q = lits[k];
+            int v = q >> 1;
+            if (seen[v] || level[v] == 0) continue;
+            bumpVariable(v);
+            seen[v] = 1;
+            if (level[v] >= decisionLevel()) pathCount++;
+            else learnt.push_back(q);
+        }
+        while (!seen[trail[index--] >> 1]) {}
+        p = trail[index + 1];
+        c = reason[p >> 1];
+        seen[p >> 1] = 0;
+        pathCount--;
+        first = false;
+    } while (pathCount > 0);
+    learnt[0] = p ^ 1;
+
+    analyzed.assign(learnt.begin() + 1, learnt.end());
+    size_t kept = 1;
+    for (size_t i = 1; i < learnt.size(); i++) {
+        if (reason[learnt[i] >> 1] == NO_REASON || !redundant(learnt[i])) learnt[kept++] = learnt[i];
+    }
+    learnt.resize(kept);
+    for (Lit l : analyzed) seen[l >> 1] = 0;
+
+    backtrackLevel = 0;
+    if (learnt.size() > 1) {
+        size_t deepest = 1;
+        for (size_t i = 2; i < learnt.size(); i++) {
+            if (level[learnt[i] >> 1] > level[learnt[deepest] >> 1]) deepest = i;
+        }
+        swap(learnt[1], learnt[deepest]);
+        backtrackLevel = level[learnt[1] >> 1];
+    }
+
+    stamp++;
+    lbd = 0;
+    for (Lit l : learnt) {
+        int lv = level[l >> 1];
+        if (levelStamp[lv] != stamp) {
+            levelStamp[lv] = stamp;
+            lbd++;
+        }
+    }
+}
+
+void SatSolver::cancelUntil(int target) {
+    if (decisionLevel() <= target) return;
+    for (int i = (int)trail.size() - 1; i >= trailLimits[target]; i--) {
+        int v = trail[i] >> 1;
+        polarity[v] = assigns[v];
+        assigns[v] = 0;
+        reason[v] = NO_REASON;
+        heapInsert(v);
+    }
+    trail.resize(trailLimits[target]);
+    trailLimits.resize(target);
+    propagated = trail.size();
+}
+
+int SatSolver::pickBranch() {
+    while (!heap.empty()) {
+        int v = heapPop();
+        if (assigns[v] == 0) return v;
+    }
+    return -1;
+}
+
+SatResult SatSolver::search(long long restartConflicts, long long maxConflicts, const function<bool()>& checkpoint) {
+    long long conflicts = 0;
+    while (true) {
+        CRef conflict = propagate();
+        if (conflict != NO_REASON) {
+            counters.conflicts++;
+            conflicts++;
+            if (decisionLevel() == 0) {
+                unsatisfiable = true;
+                return SatResult::Unsatisfiable;
+            }
+            int backtrackLevel, lbd;
+            analyze(conflict, backtrackLevel, lbd);
+            cancelUntil(backtrackLevel);
+            if (learnt.size() == 1) {
+                enqueue(learnt[0], NO_REASON);
+            }
+            else {
+                CRef c = allocate(learnt, true, lbd);
+                learntClauses.push_back(c);
+                attach(c);
+                bumpClause(c);
+                enqueue(learnt[0], c);
+            }
+            variableIncrement /= SAT_VARIABLE_DECAY;
+            clauseIncrement /= SAT_CLAUSE_DECAY;
+            counters.learnts = learntClauses.size();
+        }
+        else {
+            if (conflicts >= restartConflicts) return SatResult::Unknown;
+            int v = pickBranch();
+            if (v < 0) return SatResult::Satisfiable;
+            counters.decisions++;
+            trailLimits.push_back(trail.size());
+            enqueue(polarity[v] > 0 ? 2 * v : 2 * v + 1, NO_REASON);
+        }
+
+        if (++sinceCheckpoint >= SAT_CHECKPOINT_INTERVAL) {
+            sinceCheckpoint = 0;
+            if (!checkpoint()) stopped = true;
+        }
+        if (counters.conflicts >= maxConflicts) stopped = true;
+        if (stopped) return SatResult::Unknown;
+    }
+}
+
+SatResult SatSolver::solve(long long maxConflicts, const function<bool()>& checkpoint) {
+    cancelUntil(0);
+    stopped = false;
+    if (unsatisfiable) return SatResult::Unsatisfiable;
+    if (propagate() != NO_REASON) {
+        unsatisfiable = true;
+        return SatResult::Unsatisfiable;
+    }
+    if (counters.conflicts >= maxConflicts) return SatResult::Unknown;
+    for (int restart = 0;; restart++) {
+        SatResult result = search(lubyTerm(restart) * SAT_RESTART_CONFLICTS, maxConflicts, checkpoint);
+        if (result != SatResult::Unknown || stopped) return result;
+        cancelUntil(0);
+        counters.restarts++;
+        if (learntClauses.size() >= maxLearnts) reduceLearnts();
+    }
+}
+
+// Runs at level 0 after a restart, when the assignment is fully propagated: keeps the learnt
+// clauses over few decision levels (LBD <= 2) and the more useful half of the rest, drops
+// clauses satisfied for good and compacts the arena. Level-0 literals are never analyzed, so
+// their reasons can go.
+void SatSolver::reduceLearnts() {
+    sort(learntClauses.begin(), learntClauses.end(), [&](CRef a, CRef b) {
+        uint32_t lbdA = arena[a + 1] >> 1, lbdB = arena[b + 1] >> 1;
+        return lbdA != lbdB ? lbdA < lbdB : clauseActivity(a) > clauseActivity(b);
+    });
+    size_t half = learntClauses.size() / 2;
+
+    vector<uint32_t> compacted;
+    compacted.reserve(arena.size());
+    auto copyLive = [&](vector<CRef>& clauses, size_t keep) {
+        size_t out = 0;
+        for (size_t i = 0; i < clauses.size(); i++) {
+            CRef c = clauses[i];
+            if (i >= keep && (arena[c + 1] >> 1) > 2) continue;
+            uint32_t* lits = literals(c);
+            bool satisfied = false;
+            for (uint32_t k = 0; k < arena[c] && !satisfied; k++) satisfied = litValue(lits[k]) > 0;
+            if (satisfied) continue;
+            // Both watched literals are unassigned, so they stay in front
+            CRef moved = compacted.size();
+            compacted.insert(compacted.end(), arena.begin() + c, arena.begin() + c + HEADER);
+            uint32_t size = 0;
+            for (uint32_t k = 0; k < arena[c]; k++) {
+                if (litValue(lits[k]) == 0) {
+                    compacted.push_back(lits[k]);
+                    size++;
+                }
+            }
+            compacted[moved] = size;
+            clauses[out++] = moved;
+        }
+        clauses.resize(out);
+    };
+    copyLive(problemClauses, problemClauses.size());
+    copyLive(learntClauses, half);
+    arena.swap(compacted);
+
+    for (Lit l : trail) reason[l >> 1] = NO_REASON;
+    for (vector<Watcher>& ws : watches) ws.clear();
+    for (CRef c : problemClauses) attach(c);
+    for (CRef c : learntClauses) attach(c);
+    maxLearnts = maxLearnts * 11 / 10;
+    counters.learnts = learntClauses.size();
+}
+
+// --- Branching Heuristic ---
+
+void SatSolver::bumpVariable(int v) {
+    activity[v] += variableIncrement;
+    if (activity[v] > 1e100) {
+        for (double& a : activity) a *= 1e-100;
+        variableIncrement *= 1e-100;
+    }
+    if (heapIndex[v] >= 0) heapUp(heapIndex[v]);
+}
+
+void SatSolver::bumpClause(CRef c) {
+    float a = clauseActivity(c) + clauseIncrement;
+    setClauseActivity(c, a);
+    if (a > 1e20f) {
+        for (CRef l : learntClauses) setClauseActivity(l, clauseActivity(l) * 1e-20f);
+        clauseIncrement *= 1e-20f;
+    }
+}
+
+void SatSolver::heapInsert(int v) {
+    if (heapIndex[v] >= 0 || !decision[v]) return;
+    heapIndex[v] = heap.size();
+    heap.push_back(v);
+    heapUp(heapIndex[v]);
+}
+
+int SatSolver::heapPop() {
+    int top = heap[0];
+    heap[0] = heap.back();
+    heapIndex[heap[0]] = 0;
+    heap.pop_back();
+    heapIndex[top] = -1;
+    if (!heap.empty()) heapDown(0);
+    return top;
+}
+
+void SatSolver::heapUp(int pos) {
+    int v = heap[pos];
+    while (pos > 0) {
+        int parent = (pos - 1) >> 1;
+        if (activity[heap[parent]] >= activity[v]) break;
+        heap[pos] = heap[parent];
+        heapIndex[heap[pos]] = pos;
+        pos = parent;
+    }
+    heap[pos] = v;
+    heapIndex[v] = pos;
+}
+
+void SatSolver::heapDown(int pos) {
+    int v = heap[pos];
+    int size = heap.size();
+    while (true) {
+        int child = 2 * pos + 1;
+        if (child >= size) break;
+        if (child + 1 < size && activity[heap[child + 1]] > activity[heap[child]]) child++;
+        if (activity[heap[child]] <= activity[v]) break;
+        heap[pos] = heap[child];
+        heapIndex[heap[pos]] = pos;
+        pos = child;
+    }
+    heap[pos] = v;
+    heapIndex[v] = pos;
+}
@@ -0,0 +1,129 @@
+﻿#pragma once
+
+// Embedded CDCL SAT solver behind the "sat" engine: two watched literals, first-UIP clause
+// learning, VSIDS branching with phase saving, Luby restarts and learnt clause reduction.
+// Formulas are built as CNF in DIMACS numbering, so they can also be written out and run
+// through other solvers offline (tools/export_dimacs).
+
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <initializer_list>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// A CNF formula in DIMACS numbering: variable k > 0 is literal k, its negation -k.
+// Clauses are stored back to back, each one terminated by a 0.
+// Auxiliary variables are never branched on: once the others are set and propagated without a
+// conflict, every auxiliary left unassigned must be free to be false. That holds for the
+// at-most-one counters here and for definitions that only imply their variable (a <- b & c).
+struct CnfFormula {
+    int variables = 0;
+    size_t clauses = 0;
+    std::vector<int> literals;
+    std::vector<char> auxiliary; // By variable - 1
+
+    int newVariable(bool isAuxiliary = false) {
+        auxiliary.push_back(isAuxiliary);
+        return ++variables;
+    }
+    void addClause(std::initializer_list<int> clause);
+    void addClause(const std::vector<int>& clause);
+    // Pairwise for small groups, a sequential counter (one auxiliary variable per literal) beyond
+    void atMostOne(const std::vector<int>& group);
+    void exactlyOne(const std::vector<int>& group);
+};
+
+// Writes the formula as DIMACS CNF, preceded by each line of `comment` as a "c" line
+void writeDimacs(std::ostream& out, const CnfFormula& formula, const std::string& comment);
+
+enum class SatResult { Satisfiable, Unsatisfiable, Unknown };
+
+struct SatStats {
+    long long conflicts = 0, decisions = 0, propagations = 0, restarts = 0;
+    long long learnts = 0; // Learnt clauses currently kept
+};
+
+const int SAT_CHECKPOINT_INTERVAL = 1024; // Conflicts plus decisions between checkpoint calls
+
+class SatSolver {
+public:
+    // Loads the formula; a non-zero seed perturbs the initial branching order
+    explicit SatSolver(const CnfFormula& formula, unsigned seed = 0);
+
+    // Searches until the formula is decided, `maxConflicts` conflicts have passed, or `checkpoint`
+    // (called every SAT_CHECKPOINT_INTERVAL conflicts and decisions) returns false. Unknown in the
+    // last two cases.
+    SatResult solve(long long maxConflicts, const std::function<bool()>& checkpoint);
+
+    // The variable's value in the model after Satisfiable (false for unassigned auxiliaries), in
+    // the current partial assignment before
+    bool value(int variable) const { return assigns[variable - 1] > 0; }
+    const SatStats& stats() const { return counters; }
+
+private:
+    typedef uint32_t Lit;  // 2 * variable + 1 when negated, variables counted from 0
+    typedef uint32_t CRef; // Offset of a clause in the arena
+    static const CRef NO_REASON = UINT32_MAX;
+    static const int HEADER = 3; // Arena words before a clause's literals: size, flags | lbd, activity
+
+    struct Watcher {
+        CRef clause;
+        Lit blocker; // Some other literal of the clause; a true one spares the clause visit
+    };
+
+    std::vector<uint32_t> arena;
+    std::vector<CRef> problemClauses, learntClauses;
+    std::vector<std::vector<Watcher>> watches; // By literal: clauses with its negation watched
+
+    std::vector<int8_t> assigns;  // 1 true, -1 false, 0 unassigned
+    std::vector<int8_t> polarity; // Saved phase, 1 when the variable was last true
+    std::vector<char> decision;   // Branched on: every variable but the auxiliaries
+    std::vector<int> level;
+    std::vector<CRef> reason;
+    std::vector<Lit> trail;
+    std::vector<int> trailLimits;
+    size_t propagated = 0;
+
+    std::vector<double> activity;
+    double variableIncrement = 1;
+    float clauseIncrement = 1;
+    std::vector<int> heap, heapIndex; // Max-heap of variables by activity; heapIndex -1 when absent
+
+    std::vector<char> seen;
+    std::vector<int> levelStamp;
+    int stamp = 0;
+    std::vector<Lit> learnt, analyzed; // The clause analyze() learns; every literal it marked seen
+
+    size_t maxLearnts = 0;
+    bool unsatisfiable = false;
+    bool stopped = false;
+    int sinceCheckpoint = 0;
+    SatStats counters;
+
+    int8_t litValue(Lit l) const { int8_t v = assigns[l >> 1]; return (l & 1) ? -v : v; }
+    int decisionLevel() const { return trailLimits.size(); }
+    uint32_t* literals(CRef c) { return &arena[c + HEADER]; }
+    float clauseActivity(CRef c) const { float a; std::memcpy(&a, &arena[c + 2], sizeof(a)); return a; }
+    void setClauseActivity(CRef c, float a) { std::memcpy(&arena[c + 2], &a, sizeof(a)); }
+
+    void addProblemClause(std::vector<Lit>& clause);
+    CRef allocate(const std::vector<Lit>& lits, bool isLearnt, int lbd);
+    void attach(CRef c);
+    void enqueue(Lit l, CRef from);
+    CRef propagate();
+    void analyze(CRef conflict, int& backtrackLevel, int& lbd);
+    bool redundant(Lit l);
+    void cancelUntil(int target);
+    int pickBranch();
+    SatResult search(long long restartConflicts, long long maxConflicts, const std::function<bool()>& checkpoint);
+    void reduceLearnts();
+
+    void bumpVariable(int v);
+    void bumpClause(CRef c);
+    void heapInsert(int v);
+    int heapPop();
+    void heapUp(int pos);
+    void heapDown(int pos);
+};
@@ -0,0 +1,3246 @@
+﻿#include "solver.h"
+#include <iostream>
+#include <stack>
+#include <deque>
+#include <climits>
+#include <tuple>
+
+using namespace std;
+
+// --- Helper Functions ---
+
+GridMask toSlotMask(const vector<int>& slots) {
+    GridMask mask = 0;
+    for (int s : slots) if (s >= 0 && s < MAX_SLOTS) mask |= GridMask(1) << s;
+    return mask;
+}
+
+bool needsNoRoom(const string& courseID) {
+    return courseID == "GRAD1" || courseID == "GRAD2";
+}
+
+// --- Model Compilation ---
+
+// Builds the course -> staff inverted index and the room eligibility buckets.
+// Runs once per request after parseInputData(); validator and solver only read the result.
+void compileModel(ProblemModel& model) {
+    model.courseQualifiedStaff.clear();
+    model.roomsByKind.clear();
+
+    vector<bool> compiled(model.staffIDs.size(), false);
+    auto addQualifications = [&](const string& id, const vector<string>& qualifiedCourses) {
+        int idx = model.staffIndex[id];
+        if (compiled[idx]) return; // Duplicate ID: only the first entry counts
+        compiled[idx] = true;
+        for (const string& cID : qualifiedCourses) {
+            vector<int>& list = model.courseQualifiedStaff[cID];
+            if (list.empty() || list.back() != idx) list.push_back(idx);
+        }
+    };
+    for (auto& inst : model.instructors) addQualifications(inst.instructorID, inst.qualifiedCourses);
+    for (auto& ta : model.tas) addQualifications(ta.taID, ta.qualifiedCourses);
+
+    for (int r = 0; r < (int)model.rooms.size(); r++) {
+        const Room& room = model.rooms[r];
+        if (model.roomIndex[room.roomID] != r) continue; // Duplicate ID, shares the first entry's occupancy
+        model.roomsByKind[{room.type, ""}].push_back(r);
+        if (room.type == "Lab" && !room.labType.empty()) model.roomsByKind[{room.type, room.labType}].push_back(r);
+    }
+
+    // Symmetry classes. A duplicate room ID is its own class, as it shares the first entry's occupancy.
+    map<tuple<string, string, int>, int> roomClasses;
+    model.roomClass.resize(model.rooms.size());
+    for (int r = 0; r < (int)model.rooms.size(); r++) {
+        const Room& room = model.rooms[r];
+        model.roomClass[r] = model.roomIndex[room.roomID] != r ? r : roomClasses.emplace(make_tuple(room.type, room.labType, room.capacity), r).first->second;
+    }
+    vector<vector<string>> qualifications(model.staffIDs.size());
+    for (auto& entry : model.courseQualifiedStaff) {
+        for (int s : entry.second) qualifications[s].push_back(entry.first);
+    }
+    map<pair<vector<string>, vector<uint64_t>>, int> staffClasses;
+    model.staffClass.resize(model.staffIDs.size());
+    for (int s = 0; s < (int)model.staffIDs.size(); s++) {
+        sort(qualifications[s].begin(), qualifications[s].end());
+        const GridMask& unavailable = model.staffUnavailable[s];
+        const GridMask& preferred = model.staffPreferred[s];
+        vector<uint64_t> masks(begin(unavailable.w), end(unavailable.w));
+        masks.insert(masks.end(), begin(preferred.w), end(preferred.w));
+        model.staffClass[s] = staffClasses.emplace(make_pair(move(qualifications[s]), move(masks)), s).first->second;
+    }
+
+    // Week tables. Slots outside the grid do not exist, so the staff masks are clipped to it.
+    model.startsWithinDay.clear();
+    const WeekGrid& grid = model.grid;
+    if (!grid.valid()) return; // Reported by validateInput()
+    GridMask week = slotWindow<GridMask>(0, grid.slots());
+    for (GridMask& mask : model.staffUnavailable) mask &= week;
+    for (GridMask& mask : model.staffPreferred) mask &= week;
+    model.startsWithinDay.assign(grid.periodsPerDay + 1, GridMask());
+    for (int duration = 1; duration <= grid.periodsPerDay; duration++) {
+        for (int d = 0; d < grid.days; d++) {
+            model.startsWithinDay[duration] |= slotWindow<GridMask>(d * grid.periodsPerDay, grid.periodsPerDay - duration + 1);
+        }
+    }
+}
+
+// Attaches the immutable candidate staff/room lists to every variable
+void compileVariables(const ProblemModel& model, vector<CSPVariable>& variables) {
+    static const vector<int> none;
+    for (CSPVariable& var : variables) {
+        const Course& c = model.getCourse.at(var.courseID);
+
+        auto staffIt = model.courseQualifiedStaff.find(var.courseID);
+        var.candidateStaff = staffIt != model.courseQualifiedStaff.end() ? staffIt->second : none;
+
+        var.candidateRooms.clear();
+        if (needsNoRoom(var.courseID)) {
+            var.candidateRooms.push_back(-1);
+            continue;
+        }
+        string labKey = (c.type == "Lab") ? c.labType : "";
+        auto roomIt = model.roomsByKind.find({ c.type, labKey });
+        if (roomIt == model.roomsByKind.end()) continue;
+        for (int r : roomIt->second) {
+            // Capacity Check: Must hold total students of all combined sections
+            if (model.rooms[r].capacity >= var.totalStudents) var.candidateRooms.push_back(r);
+        }
+    }
+}
+
+// --- Validation Logic (New) ---
+
+vector<string> validateInput(const ProblemModel& model) {
+    vector<string> errors;
+
+    // 1. Check if assigned courses exist
+    for (const auto& sec : model.sections) {
+        for (const auto& cID : sec.assignedCourses) {
+            if (model.getCourse.find(cID) == model.getCourse.end()) {
+                errors.push_back("Section " + sec.sectionID + " is assigned unknown course: " + cID);
+            }
+        }
+    }
+
+    // 2. Check if every course has at least one qualified instructor
+    for (const auto& course : model.courses) {
+        if (!model.courseQualifiedStaff.count(course.courseID)) {
+            errors.push_back("Course " + course.courseName + " (" + course.courseID + ") has no qualified instructors or TAs.");
+        }
+    }
+
+    // 3. Check the week grid, and that every course fits in one day of it
+    const WeekGrid& grid = model.grid;
+    if (!grid.valid()) {
+        errors.push_back("Grid of " + to_string(grid.days) + " days x " + to_string(grid.periodsPerDay) + " periods is not supported (at least 1 x 1, at most " + to_string(MAX_SLOTS) + " slots).");
+        return errors;
+    }
+    for (const auto& course : model.courses) {
+        if (course.duration < 1 || course.duration > grid.periodsPerDay) {
+            errors.push_back("Course " + course.courseName + " (" + course.courseID + ") has duration " + to_string(course.duration) + ", which does not fit in a day of " + to_string(grid.periodsPerDay) + " periods.");
+        }
+    }
+
+    return errors;
+}
+
+// --- Pre-solve Analysis ---
+
+// Maximum flow (Dinic) on the small bipartite networks of the capacity bounds below
+struct FlowNetwork {
+    struct Edge { int to; long long cap; };
+    vector<Edge> edges; // Paired: edge i ^ 1 is the residual of edge i
+    vector<vector<int>> out;
+    vector<int> level, next;
+
+    explicit FlowNetwork(int nodes) : out(nodes), level(nodes), next(nodes) {}
+
+    void addEdge(int from, int to, long long cap) {
+        out[from].push_back(edges.size());
+        edges.push_back({ to, cap });
+        out[to].push_back(edges.size());
+        edges.push_back({ from, 0 });
+    }
+
+    // Residual BFS from the source; afterwards level[u] >= 0 marks the source side of a minimum cut
+    bool buildLevels(int source, int sink) {
+        fill(level.begin(), level.end(), -1);
+        deque<int> queue = { source };
+        level[source] = 0;
+        while (!queue.empty()) {
+            int u = queue.front();
+            queue.pop_front();
+            for (int e : out[u]) {
+                if (edges[e].cap > 0 && level[edges[e].to] < 0) {
+                    level[edges[e].to] = level[u] + 1;
+                    queue.push_back(edges[e].to);
+                }
+            }
+        }
+        return level[sink] >= 0;
+    }
+
+    long long push(int u, int sink, long long limit) {
+        if (u == sink) return limit;
+        for (; next[u] < (int)out[u].size(); next[u]++) {
+            Edge& edge = edges[out[u][next[u]]];
+            if (edge.cap <= 0 || level[edge.to] != level[u] + 1) continue;
+            long long pushed = push(edge.to, sink, min(limit, edge.cap));
+            if (pushed > 0) {
+                edge.cap -= pushed;
+                edges[out[u][next[u]] ^ 1].cap += pushed;
+                return pushed;
+            }
+        }
+        return 0;
+    }
+
+    long long maxFlow(int source, int sink) {
+        long long flow = 0;
+        while (buildLevels(source, sink)) {
+            fill(next.begin(), next.end(), 0);
+            while (long long pushed = push(source, sink, LLONG_MAX)) flow += pushed;
+        }
+        return flow;
+    }
+};
+
+// "A, B, C and 4 more"
+string nameList(const vector<string>& names, size_t shown = 5) {
+    string out;
+    for (size_t i = 0; i < names.size() && i < shown; i++) {
+        if (i) out += (i + 1 == names.size() ? " and " : ", ");
+        out += names[i];
+    }
+    if (names.size() > shown) out += " and " + to_string(names.size() - shown) + " more";
+    return out;
+}
+
+// Hall-type bound between classes and one kind of resource. Every class needs `duration` periods
+// of one of its candidates, and resource r offers capacity[r] periods. Classes with the same
+// candidate list form one source node. If not even a fractional assignment places every period,
+// the source side of the minimum cut is a set of resources whose classes (those that can use
+// nothing else) need more periods than it offers; that set is described. "" when the bound holds.
+string resourceOverload(const ProblemModel& model, const vector<CSPVariable>& variables, vector<int> CSPVariable::* candidates, const vector<long long>& capacity,
+    const function<string(int)>& resourceName, const string& one, const string& many, const string& onlyIt, const string& onlyThem) {
+    map<vector<int>, int> groupOf;
+    vector<vector<int>> groupVariables;
+    for (int v = 0; v < (int)variables.size(); v++) {
+        const vector<int>& list = variables[v].*candidates;
+        if (list.empty() || list[0] < 0) continue; // No room needed, or reported on its own
+        auto it = groupOf.emplace(list, groupVariables.size()).first;
+        if (it->second == (int)groupVariables.size()) groupVariables.emplace_back();
+        groupVariables[it->second].push_back(v);
+    }
+
+    int groups = groupVariables.size(), count = capacity.size();
+    int source = groups + count, sink = source + 1;
+    FlowNetwork network(sink + 1);
+    long long demand = 0;
+    for (auto& entry : groupOf) {
+        long long periods = 0;
+        for (int v : groupVariables[entry.second]) periods += variables[v].duration;
+        demand += periods;
+        network.addEdge(source, entry.second, periods);
+        for (int r : entry.first) network.addEdge(entry.second, groups + r, LLONG_MAX);
+    }
+    for (int r = 0; r < count; r++) network.addEdge(groups + r, sink, capacity[r]);
+    if (network.maxFlow(source, sink) >= demand) return "";
+
+    network.buildLevels(source, sink);
+    vector<string> names, courses;
+    long long offered = 0, needed = 0;
+    int classes = 0;
+    for (int r = 0; r < count; r++) {
+        if (network.level[groups + r] < 0) continue;
+        names.push_back(resourceName(r));
+        offered += capacity[r];
+    }
+    unordered_set<int> seenCourses;
+    for (int g = 0; g < groups; g++) {
+        if (network.level[g] < 0) continue;
+        for (int v : groupVariables[g]) {
+            needed += variables[v].duration;
+            classes++;
+            if (seenCourses.insert(variables[v].courseIdx).second) courses.push_back(model.courses[variables[v].courseIdx].courseName);
+        }
+    }
+    bool single = names.size() == 1;
+    return (single ? one : many) + " " + nameList(names) + (single ? " has " : " have ") + to_string(offered) + " free periods" + (single ? "" : " between them")
+        + ", but the " + to_string(classes) + " classes " + (single ? onlyIt : onlyThem) + " need " + to_string(needed) + " (" + nameList(courses) + ").";
+}
+
+// Necessary conditions checked before any search, each failure naming the over-subscribed
+// resource: classes without an eligible room, sections booked beyond the week, and the staff and
+// room capacity bounds above. Runs in milliseconds; an empty result does not promise a solution.
+vector<string> analyzeFeasibility(const ProblemModel& model, const vector<CSPVariable>& variables) {
+    vector<string> problems;
+    const WeekGrid& grid = model.grid;
+
+    unordered_set<int> reportedCourses;
+    for (const CSPVariable& var : variables) {
+        if (!var.candidateRooms.empty() || !reportedCourses.insert(var.courseIdx).second) continue;
+        const Course& c = model.courses[var.courseIdx];
+        string kind = c.type + (c.type == "Lab" && !c.labType.empty() ? " (" + c.labType + ")" : "");
+        bool anyOfKind = model.roomsByKind.count({ c.type, c.type == "Lab" ? c.labType : "" }) > 0;
+        problems.push_back("Course " + c.courseName + " (" + c.courseID + ") needs a " + kind + " room for " + to_string(var.totalStudents) + " students, but "
+            + (anyOfKind ? "none is that large." : "there is no such room."));
+    }
+
+    vector<long long> sectionLoad(model.sections.size(), 0);
+    for (const CSPVariable& var : variables) {
+        for (int secIdx : var.targetSectionIndices) sectionLoad[secIdx] += var.duration;
+    }
+    for (size_t s = 0; s < model.sections.size(); s++) {
+        if (sectionLoad[s] > grid.slots()) {
+            problems.push_back("Section " + model.sections[s].sectionID + " has " + to_string(sectionLoad[s]) + " periods of classes, but the week has " + to_string(grid.slots()) + ".");
+        }
+    }
+
+    vector<long long> staffFree(model.staffIDs.size());
+    for (size_t s = 0; s < staffFree.size(); s++) staffFree[s] = grid.slots() - popCount(model.staffUnavailable[s]);
+    string staffProblem = resourceOverload(model, variables, &CSPVariable::candidateStaff, staffFree,
+        [&](int s) { return model.staffIDs[s]; }, "Staff member", "Staff", "only they can teach", "only they can teach");
+    if (!staffProblem.empty()) problems.push_back(staffProblem);
+
+    vector<long long> roomFree(model.rooms.size(), grid.slots());
+    string roomProblem = resourceOverload(model, variables, &CSPVariable::candidateRooms, roomFree,
+        [&](int r) { return model.rooms[r].roomID; }, "Room", "Rooms", "that can only use it", "that can only use them");
+    if (!roomProblem.empty()) problems.push_back(roomProblem);
+
+    return problems;
+}
+
+// --- Soft Constraints ---
+
+// Penalty of one resource's teaching on one day: idle periods between its first and last class,
+// plus the squared load so that classes spread evenly across the week
+template <class Mask>
+inline long long dayPenalty(const ObjectiveWeights& w, Mask dayBits) {
+    if (!dayBits) return 0;
+    int first = lowestBit(dayBits), last = highestBit(dayBits);
+    long long load = popCount(dayBits);
+    return w.gaps * (last - first + 1 - load) + w.dailyLoad * load * load;
+}
+
+// Change in one resource's penalty when the window is added to its (window-free) teaching mask.
+// Classes never cross a day boundary, so only the window's own day changes.
+template <class Mask>
+inline long long resourceDelta(const ObjectiveWeights& w, const WeekGrid& grid, Mask teaching, Mask window) {
+    int periods = grid.periodsPerDay;
+    Mask day = slotWindow<Mask>(lowestBit(window) / periods * periods, periods);
+    return dayPenalty(w, (teaching | window) & day) - dayPenalty(w, teaching & day);
+}
+
+// Objective change of placing the value on the current board. Only touched (resource, day)
+// pairs are evaluated, so the objective is kept as a running total instead of rescanning the week.
+template <class Mask>
+long long moveDelta(const SolverState<Mask>& st, const CSPVariable& var, const CSPValue& val) {
+    const ProblemModel& model = *st.model;
+    const ObjectiveWeights& w = model.weights;
+    Mask window = slotWindow<Mask>(val.startSlot, var.duration);
+    long long delta = 0;
+    for (int secIdx : var.targetSectionIndices) delta += resourceDelta(w, model.grid, st.sectionBusy[secIdx], window);
+    delta += resourceDelta(w, model.grid, st.staffBusy[val.staffIdx] & ~narrowMask<Mask>(model.staffUnavailable[val.staffIdx]), window);
+    Mask preferred = narrowMask<Mask>(model.staffPreferred[val.staffIdx]);
+    if (preferred) delta += w.preference * popCount(window & ~preferred);
+    return delta;
+}
+
+// Unweighted totals of the whole board, for reporting and to seed the running objective
+template <class Mask>
+ObjectiveTerms evaluateObjective(const SolverState<Mask>& st, const vector<CSPVariable>& variables) {
+    const ProblemModel& model = *st.model;
+    ObjectiveWeights gapsOnly{ 0, 1, 0 }, loadOnly{ 0, 0, 1 };
+    ObjectiveTerms terms;
+    const WeekGrid& grid = model.grid;
+    auto addResource = [&](Mask teaching) {
+        for (int d = 0; d < grid.days; d++) {
+            Mask day = teaching & slotWindow<Mask>(d * grid.periodsPerDay, grid.periodsPerDay);
+            terms.gaps += dayPenalty(gapsOnly, day);
+            terms.dailyLoad += dayPenalty(loadOnly, day);
+        }
+    };
+    for (const Mask& busy : st.sectionBusy) addResource(busy);
+    for (size_t s = 0; s < st.staffBusy.size(); s++) addResource(st.staffBusy[s] & ~narrowMask<Mask>(model.staffUnavailable[s]));
+    for (size_t v = 0; v < variables.size(); v++) {
+        const CSPValue& val = st.assignedValue[v];
+        Mask preferred = narrowMask<Mask>(model.staffPreferred[val.staffIdx]);
+        if (preferred) terms.preference += popCount(slotWindow<Mask>(val.startSlot, variables[v].duration) & ~preferred);
+    }
+    return terms;
+}
+
+long long weightedObjective(const ObjectiveWeights& w, const ObjectiveTerms& terms) {
+    return w.preference * terms.preference + w.gaps * terms.gaps + w.dailyLoad * terms.dailyLoad;
+}
+
+// --- CSP Logic ---
+
+template <class Mask>
+bool isInstructorAvailable(const SolverState<Mask>& st, int staffIdx, int startSlot, int duration) {
+    return (st.staffBusy[staffIdx] & slotWindow<Mask>(startSlot, duration)) == 0;
+}
+
+template <class Mask>
+bool isRoomAvailable(const SolverState<Mask>& st, int roomIdx, int startSlot, int duration) {
+    return roomIdx < 0 || (st.roomBusy[roomIdx] & slotWindow<Mask>(startSlot, duration)) == 0;
+}
+
+template <class Mask>
+void applyMove(SolverState<Mask>& st, const CSPVariable& var, const CSPValue& val) {
+    if (st.trackObjective) st.objective += moveDelta(st, var, val);
+
+    Mask window = slotWindow<Mask>(val.startSlot, var.duration);
+    Mask start = Mask(1) << val.startSlot;
+    int slots = st.model->grid.slots();
+    for (int secIdx : var.targetSectionIndices) {
+        st.sectionBusy[secIdx] |= window;
+        st.classStarts[secIdx] |= start;
+
+        int entry = secIdx * slots + val.startSlot;
+        st.classCourse[entry] = var.courseIdx;
+        st.classStaff[entry] = val.staffIdx;
+        st.classRoom[entry] = val.roomIdx;
+        st.classDuration[entry] = (uint8_t)var.duration;
+    }
+
+    st.staffBusy[val.staffIdx] |= window;
+    st.staffLoad[val.staffIdx]++;
+    if (val.roomIdx >= 0) {
+        st.roomBusy[val.roomIdx] |= window;
+        st.roomLoad[val.roomIdx]++;
+    }
+}
+
+template <class Mask>
+void undoMove(SolverState<Mask>& st, const CSPVariable& var, const CSPValue& val) {
+    Mask window = slotWindow<Mask>(val.startSlot, var.duration);
+    Mask start = Mask(1) << val.startSlot;
+    for (int secIdx : var.targetSectionIndices) {
+        st.sectionBusy[secIdx] &= ~window;
+        st.classStarts[secIdx] &= ~start;
+    }
+
+    // A move is only applied over a free window, so clearing it never drops an unavailable bit
+    st.staffBusy[val.staffIdx] &= ~window;
+    st.staffLoad[val.staffIdx]--;
+    if (val.roomIdx >= 0) {
+        st.roomBusy[val.roomIdx] &= ~window;
+        st.roomLoad[val.roomIdx]--;
+    }
+
+    if (st.trackObjective) st.objective -= moveDelta(st, var, val);
+}
+
+template <class Mask>
+bool isValidMove(const SolverState<Mask>& st, const CSPVariable& var, const CSPValue& val) {
+    st.counters.validMoveChecks++;
+    const ProblemModel& model = *st.model;
+    if (val.startSlot < 0 || val.startSlot >= model.grid.slots()) return false;
+    if (!(narrowMask<Mask>(model.startsWithinDay[var.duration]) & (Mask(1) << val.startSlot))) return false; // Crosses into the next day
+    // Constraint: Slots larger than 1 hour should align (heuristic, optional)
+    // if (var.duration > 1 && val.startSlot % var.duration != 0) return false; 
+
+    if (!isInstructorAvailable(st, val.staffIdx, val.startSlot, var.duration)) {
+        st.counters.instructorRejections++;
+        return false;
+    }
+    if (!isRoomAvailable(st, val.roomIdx, val.startSlot, var.duration)) {
+        st.counters.roomRejections++;
+        return false;
+    }
+
+    if (sectionsOccupancy(st, var.targetSectionIndices) & slotWindow<Mask>(val.startSlot, var.duration)) {
+        st.counters.sectionRejections++;
+        return false;
+    }
+
+    return true;
+}
+
+// Recomputes a variable's live start mask from the current occupancy
+template <class Mask>
+Mask computeLiveStarts(const SolverState<Mask>& st, const CSPVariable& var) {
+    Mask fits = narrowMask<Mask>(st.model->startsWithinDay[var.duration]);
+    Mask starts = freeStarts(sectionsOccupancy(st, var.targetSectionIndices), var.duration, fits);
+    if (!starts) return 0;
+
+    Mask staffStarts = 0;
+    for (int staffIdx : var.candidateStaff) staffStarts |= freeStarts(st.staffBusy[staffIdx], var.duration, fits);
+    starts &= staffStarts;
+    if (!starts) return 0;
+
+    Mask roomStarts = 0;
+    for (int roomIdx : var.candidateRooms) {
+        roomStarts |= roomIdx < 0 ? ~Mask(0) : freeStarts(st.roomBusy[roomIdx], var.duration, fits);
+    }
+    return starts & roomStarts;
+}
+
+// Lists, per section/staff/room, the variables whose domain depends on it
+template <class Mask>
+void buildWatchLists(SolverState<Mask>& st, const vector<CSPVariable>& variables) {
+    const ProblemModel& model = *st.model;
+    st.sectionWatchers.assign(model.sections.size(), vector<int>());
+    st.staffWatchers.assign(model.staffIDs.size(), vector<int>());
+    st.roomWatchers.assign(model.rooms.size(), vector<int>());
+    for (int v = 0; v < (int)variables.size(); v++) {
+        for (int secIdx : variables[v].targetSectionIndices) st.sectionWatchers[secIdx].push_back(v);
+        for (int staffIdx : variables[v].candidateStaff) st.staffWatchers[staffIdx].push_back(v);
+        for (int roomIdx : variables[v].candidateRooms) if (roomIdx >= 0) st.roomWatchers[roomIdx].push_back(v);
+    }
+}
+
+// --- Variable Ordering ---
+
+VariableOrdering parseVariableOrdering(const string& name) {
+    if (name == "static") return VariableOrdering::Static;
+    if (name == "mrv") return VariableOrdering::MRV;
+    return VariableOrdering::DomWdeg;
+}
+
+SolverEngine parseSolverEngine(const string& name) {
+    if (name == "local") return SolverEngine::LocalSearch;
+    if (name == "sat") return SolverEngine::Sat;
+    if (name == "auto") return SolverEngine::Auto;
+    return SolverEngine::Backtrack;
+}
+
+string solverEngineName(SolverEngine engine) {
+    switch (engine) {
+    case SolverEngine::LocalSearch: return "local";
+    case SolverEngine::Sat: return "sat";
+    case SolverEngine::Auto: return "auto";
+    default: return "backtrack";
+    }
+}
+
+template <class Mask>
+void bucketInsert(SolverState<Mask>& st, int v) {
+    vector<int>& bucket = st.domainBuckets[popCount(st.liveStarts[v])];
+    st.bucketSlot[v] = bucket.size();
+    bucket.push_back(v);
+}
+
+template <class Mask>
+void bucketErase(SolverState<Mask>& st, int v) {
+    vector<int>& bucket = st.domainBuckets[popCount(st.liveStarts[v])];
+    int last = bucket.back();
+    bucket[st.bucketSlot[v]] = last;
+    st.bucketSlot[last] = st.bucketSlot[v];
+    bucket.pop_back();
+}
+
+// Every liveStarts change goes through here so the buckets stay in sync
+template <class Mask>
+inline void setLiveStarts(SolverState<Mask>& st, int v, Mask mask) {
+    if (st.isAssigned[v]) { st.liveStarts[v] = mask; return; }
+    bucketErase(st, v);
+    st.liveStarts[v] = mask;
+    bucketInsert(st, v);
+}
+
+template <class Mask>
+void initVariableOrdering(SolverState<Mask>& st, const vector<CSPVariable>& variables) {
+    int n = variables.size();
+    st.varDegree.assign(n, 0);
+    for (int v = 0; v < n; v++) {
+        for (int secIdx : variables[v].targetSectionIndices) st.varDegree[v] += st.sectionWatchers[secIdx].size() - 1;
+        for (int staffIdx : variables[v].candidateStaff) st.varDegree[v] += st.staffWatchers[staffIdx].size() - 1;
+        for (int roomIdx : variables[v].candidateRooms) if (roomIdx >= 0) st.varDegree[v] += st.roomWatchers[roomIdx].size() - 1;
+    }
+    if ((int)st.varWeight.size() != n) st.varWeight.assign(n, 1);
+    if ((int)st.varTieRank.size() != n) {
+        st.varTieRank.resize(n);
+        for (int v = 0; v < n; v++) st.varTieRank[v] = v;
+    }
+
+    st.domainBuckets.assign(st.model->grid.slots() + 1, vector<int>());
+    st.bucketSlot.assign(n, 0);
+    for (int v = 0; v < n; v++) bucketInsert(st, v);
+}
+
+// Picks the next unassigned variable according to variableOrdering
+template <class Mask>
+int selectVariable(SolverState<Mask>& st) {
+    auto breaksTie = [&](int a, int b) {
+        if (st.varDegree[a] != st.varDegree[b]) return st.varDegree[a] > st.varDegree[b];
+        return st.varTieRank[a] < st.varTieRank[b];
+    };
+
+    int best = -1;
+    if (st.variableOrdering == VariableOrdering::Static) {
+        for (auto& bucket : st.domainBuckets) {
+            for (int v : bucket) if (best < 0 || st.varTieRank[v] < st.varTieRank[best]) best = v;
+        }
+        return best;
+    }
+
+    if (st.variableOrdering == VariableOrdering::MRV) {
+        for (auto& bucket : st.domainBuckets) {
+            if (bucket.empty()) continue;
+            for (int v : bucket) if (best < 0 || breaksTie(v, best)) best = v;
+            return best;
+        }
+        return best;
+    }
+
+    // dom/wdeg: a bucket of size b cannot beat the best ratio once b / maxWeight >= best
+    int maxWeight = 1;
+    for (auto& bucket : st.domainBuckets) for (int v : bucket) maxWeight = max(maxWeight, st.varWeight[v]);
+    double bestScore = 0;
+    for (int size = 0; size < (int)st.domainBuckets.size(); size++) {
+        if (best >= 0 && (double)size / maxWeight >= bestScore) break;
+        for (int v : st.domainBuckets[size]) {
+            double score = (double)size / st.varWeight[v];
+            if (best < 0 || score < bestScore || (score == bestScore && breaksTie(v, best))) {
+                best = v;
+                bestScore = score;
+            }
+        }
+    }
+    return best;
+}
+
+// Shrinks the live domains of unassigned variables that share a section, staff member or room
+// with the move just applied at `depth`. Old masks go on domainTrail and the depth is added to the
+// pruneSet of every variable that loses values. Returns the wiped-out variable, or -1.
+template <class Mask>
+int propagateMove(SolverState<Mask>& st, const vector<CSPVariable>& variables, int varPos, const CSPValue& val, int depth) {
+    if (st.seenStamp.size() != variables.size()) { st.seenStamp.assign(variables.size(), 0); st.stamp = 0; }
+    st.stamp++;
+
+    Mask window = slotWindow<Mask>(val.startSlot, variables[varPos].duration);
+    int wipedOut = -1;
+    auto revise = [&](const vector<int>& watchers) {
+        for (int u : watchers) {
+            if (wipedOut >= 0) return;
+            if (st.isAssigned[u] || st.seenStamp[u] == st.stamp) continue;
+            st.seenStamp[u] = st.stamp;
+
+            // A move can only remove values whose window overlaps its own
+            if (!(st.liveStarts[u] & overlappingStarts(window, variables[u].duration))) continue;
+            st.pruneSets[u].set(depth);
+            st.pruneTrail.push_back(u);
+
+            Mask updated = computeLiveStarts(st, variables[u]);
+            if (updated == st.liveStarts[u]) continue;
+            st.domainTrail.push_back({ u, st.liveStarts[u] });
+            setLiveStarts(st, u, updated);
+            if (!updated) {
+                wipedOut = u;
+                st.varWeight[u]++;
+                st.varWeight[varPos]++;
+            }
+        }
+    };
+
+    for (int secIdx : variables[varPos].targetSectionIndices) revise(st.sectionWatchers[secIdx]);
+    revise(st.staffWatchers[val.staffIdx]);
+    if (val.roomIdx >= 0) revise(st.roomWatchers[val.roomIdx]);
+    return wipedOut;
+}
+
+// Undoes the propagation done at `depth` back to its trail marks
+template <class Mask>
+void restoreDomains(SolverState<Mask>& st, size_t trailMark, size_t pruneMark, int depth) {
+    while (st.domainTrail.size() > trailMark) {
+        setLiveStarts(st, st.domainTrail.back().first, st.domainTrail.back().second);
+        st.domainTrail.pop_back();
+    }
+    while (st.pruneTrail.size() > pruneMark) {
+        st.pruneSets[st.pruneTrail.back()].reset(depth);
+        st.pruneTrail.pop_back();
+    }
+}
+
+// --- Nogood Store ---
+
+// Hashes a literal for the watch lists. Staff and room indices are truncated to 16 bits, so two
+// values of one variable can share a key; violatesNogood compares the full value.
+inline uint64_t nogoodKey(int var, const CSPValue& val) {
+    return (uint64_t(var) << 40) | (uint64_t(val.startSlot & 0xFF) << 32) |
+        (uint64_t((val.staffIdx + 1) & 0xFFFF) << 16) | uint64_t((val.roomIdx + 1) & 0xFFFF);
+}
+
+template <class Mask>
+void clearNogoods(SolverState<Mask>& st) {
+    st.nogoods.clear();
+    st.nogoodWatch.clear();
+    st.nogoodHead = 0;
+}
+
+// Stores the assignments at the conflict-set depths as a nogood (skipped when too long to pay off)
+template <class Mask>
+void recordNogood(SolverState<Mask>& st, const DepthSet& conflict, const vector<int>& order) {
+    if (conflict.count() > MAX_NOGOOD_SIZE) return;
+
+    Nogood ng;
+    conflict.forEach([&](int d) { ng.literals.push_back({ order[d], st.assignedValue[order[d]] }); });
+
+    int id;
+    if (st.nogoods.size() < MAX_NOGOODS) {
+        id = st.nogoods.size();
+        st.nogoods.push_back(ng);
+    }
+    else {
+        id = st.nogoodHead;
+        st.nogoodHead = (st.nogoodHead + 1) % MAX_NOGOODS;
+        for (auto& lit : st.nogoods[id].literals) {
+            vector<int>& ids = st.nogoodWatch[nogoodKey(lit.first, lit.second)];
+            ids.erase(remove(ids.begin(), ids.end(), id), ids.end());
+        }
+        st.nogoods[id] = ng;
+    }
+    for (auto& lit : st.nogoods[id].literals) st.nogoodWatch[nogoodKey(lit.first, lit.second)].push_back(id);
+}
+
+// True if assigning val to var would complete a stored nogood; the depths of its other
+// literals are added to the conflict set as the reason
+template <class Mask>
+bool violatesNogood(SolverState<Mask>& st, int var, const CSPValue& val, DepthSet& conflict) {
+    if (st.nogoods.empty()) return false;
+    auto it = st.nogoodWatch.find(nogoodKey(var, val));
+    if (it == st.nogoodWatch.end()) return false;
+
+    for (int id : it->second) {
+        bool complete = true;
+        for (auto& lit : st.nogoods[id].literals) {
+            if (lit.first == var) {
+                if (!(lit.second == val)) {
+                    complete = false;
+                    break;
+                }
+                continue;
+            }
+            if (!st.isAssigned[lit.first] || st.varDepth[lit.first] < 0 || !(st.assignedValue[lit.first] == lit.second)) {
+                complete = false;
+                break;
+            }
+        }
+        if (!complete) continue;
+        for (auto& lit : st.nogoods[id].literals) if (lit.first != var) conflict.set(st.varDepth[lit.first]);
+        return true;
+    }
+    return false;
+}
+
+// Keeps the candidates that are in use, plus the first unused one of each symmetry class.
+// Unused members of a class are interchangeable: swapping two of them maps every timetable
+// below one onto a timetable below the other, so branching on more than one repeats a subtree.
+// The swap leaves the assignments made so far alone, so the conflict sets of CBJ still hold.
+inline void symmetryRepresentatives(const vector<int>& candidates, const vector<int>& load, const vector<int>& classOf, vector<int>& out, long long& skipped) {
+    out.clear();
+    for (size_t i = 0; i < candidates.size(); i++) {
+        int c = candidates[i];
+        bool copy = false;
+        if (c >= 0 && load[c] == 0) {
+            for (size_t j = 0; j < i && !copy; j++) {
+                int earlier = candidates[j];
+                copy = earlier >= 0 && load[earlier] == 0 && classOf[earlier] == classOf[c];
+            }
+        }
+        if (copy) skipped++;
+        else out.push_back(c);
+    }
+}
+
+// Points the cursor at the start of a variable's live domain. Unused interchangeable staff and
+// rooms contribute one representative each (see above), chosen against the current state.
+template <class Mask>
+void openDomain(const SolverState<Mask>& st, const CSPVariable& var, Mask starts, DomainCursor<Mask>& cursor) {
+    const ProblemModel& model = *st.model;
+    symmetryRepresentatives(var.candidateStaff, st.staffLoad, model.staffClass, cursor.staff, st.counters.symmetrySkips);
+    symmetryRepresentatives(var.candidateRooms, st.roomLoad, model.roomClass, cursor.rooms, st.counters.symmetrySkips);
+    cursor.starts = starts;
+    cursor.staffPos = 0;
+    cursor.roomPos = 0;
+    cursor.preferred = { -1, -1, -1 };
+    cursor.preferredPending = false;
+    cursor.produced = 0;
+}
+
+// Produces a valid value to try before the rest of the domain. It may use a staff member or room
+// that symmetry breaking left out; adding a valid value back never loses a solution.
+template <class Mask>
+void preferValue(DomainCursor<Mask>& cursor, const CSPValue& val) {
+    cursor.preferred = val;
+    cursor.preferredPending = true;
+}
+
+// Advances to the next value of the domain: by start, then staff, then room. Returns false once
+// the domain is exhausted.
+template <class Mask>
+bool nextValue(const SolverState<Mask>& st, const CSPVariable& var, DomainCursor<Mask>& cursor, CSPValue& val) {
+    if (cursor.preferredPending) {
+        cursor.preferredPending = false;
+        cursor.produced++;
+        val = cursor.preferred;
+        return true;
+    }
+    for (; cursor.starts; cursor.starts &= cursor.starts - 1, cursor.staffPos = 0) {
+        int slot = lowestBit(cursor.starts);
+
+        for (; cursor.staffPos < cursor.staff.size(); cursor.staffPos++, cursor.roomPos = 0) {
+            int staffIdx = cursor.staff[cursor.staffPos];
+            // Optimization: check instructor availability before checking rooms
+            if (!isInstructorAvailable(st, staffIdx, slot, var.duration)) continue;
+
+            while (cursor.roomPos < cursor.rooms.size()) {
+                int roomIdx = cursor.rooms[cursor.roomPos++];
+                if (!isRoomAvailable(st, roomIdx, slot, var.duration)) continue;
+                CSPValue next = { slot, staffIdx, roomIdx };
+                if (next == cursor.preferred) continue; // Produced first already
+                cursor.produced++;
+                val = next;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// --- Variable Identification (Modified for allYear logic) ---
+
+vector<CSPVariable> identifyVariables(const ProblemModel& model) {
+    vector<CSPVariable> variables;
+    int varIdCounter = 0;
+
+    unordered_set<string> processedGroupCourses;
+    unordered_set<string> processedYearCourses; // Track yearly courses
+
+    for (int i = 0; i < (int)model.sections.size(); i++) {
+        const Section& sec = model.sections[i];
+
+        for (const string& cID : sec.assignedCourses) {
+            if (model.getCourse.find(cID) == model.getCourse.end()) continue;
+            const Course& c = model.getCourse.at(cID);
+
+            if (c.allYear) {
+                // New Logic: Group by Year
+                string yearKey = to_string(sec.year) + "_" + cID;
+                if (processedYearCourses.count(yearKey)) continue;
+
+                CSPVariable var;
+                var.id = varIdCounter++;
+                var.courseID = cID;
+                var.courseIdx = model.courseIndex.at(cID);
+                var.isHardConstraint = needsNoRoom(cID);
+                var.duration = c.duration;
+
+                // Get all sections for this year
+                if (model.yearToSectionIndices.count(sec.year)) {
+                    var.targetSectionIndices = model.yearToSectionIndices.at(sec.year);
+                }
+                else {
+                    var.targetSectionIndices.push_back(i); // Fallback
+                }
+
+                var.totalStudents = 0;
+                for (int idx : var.targetSectionIndices) var.totalStudents += model.sections[idx].studentCount;
+
+                variables.push_back(var);
+                processedYearCourses.insert(yearKey);
+            }
+            else if (c.type == "Lecture") {
+                // Existing Logic: Group by GroupID
+                string groupKey = sec.groupID + "_" + cID;
+                if (processedGroupCourses.count(groupKey)) continue;
+
+                CSPVariable var;
+                var.id = varIdCounter++;
+                var.courseID = cID;
+                var.courseIdx = model.courseIndex.at(cID);
+                var.isHardConstraint = needsNoRoom(cID);
+                var.duration = c.duration;
+
+                if (model.groupToSectionIndices.count(sec.groupID)) {
+                    var.targetSectionIndices = model.groupToSectionIndices.at(sec.groupID);
+                }
+                else {
+                    var.targetSectionIndices.push_back(i);
+                }
+
+                var.totalStudents = 0;
+                for (int idx : var.targetSectionIndices) var.totalStudents += model.sections[idx].studentCount;
+
+                variables.push_back(var);
+                processedGroupCourses.insert(groupKey);
+            }
+            else {
+                // Individual Sections (Labs/Tutorials usually)
+                CSPVariable var;
+                var.id = varIdCounter++;
+                var.courseID = cID;
+                var.courseIdx = model.courseIndex.at(cID);
+                var.targetSectionIndices.push_back(i);
+                var.totalStudents = sec.studentCount;
+                var.duration = c.duration;
+                var.isHardConstraint = false;
+
+                variables.push_back(var);
+            }
+        }
+    }
+
+    return variables;
+}
+
+// --- Solver ---
+
+template <class Mask>
+void reportProgress(SolverState<Mask>& st, int depth) {
+    int newIterations = st.iterationCount - st.reportedIterations;
+    st.reportedIterations = st.iterationCount;
+    st.counters.iterations += newIterations;
+    SolveProgress* progress = st.control.progress;
+    if (!progress) return;
+    progress->iterations += newIterations;
+    depth += st.fixedVariables;
+    progress->depth = depth;
+    int best = progress->bestDepth.load();
+    while (depth > best && !progress->bestDepth.compare_exchange_weak(best, depth)) {}
+}
+
+template <class Mask>
+bool solveIterative(SolverState<Mask>& st, const vector<CSPVariable>& variables) {
+    const ProblemModel& model = *st.model;
+    int n = variables.size();
+    st.provedInfeasible = false;
+    st.reportedIterations = st.iterationCount;
+    if (n == 0) return true;
+
+    vector<DomainCursor<Mask>> cursors(n); // cursors[depth]: the node's domain, reopened by every node at that depth
+    vector<size_t> trailMarks(n, 0), pruneMarks(n, 0);
+    vector<int> order(n, -1); // order[depth] = variable assigned at that depth
+    int depth = 0;
+
+    // Tracing costs one predictable branch per decision when off; records reuse the iteration's clock read
+    SearchTrace* trace = st.control.trace;
+    uint32_t run = trace ? trace->beginRun() : 0;
+    auto traceEvent = [&](chrono::steady_clock::time_point now, TraceEvent event, int v, int value) {
+        if (trace) trace->record(run, now, event, depth, variables[v].id, value);
+    };
+    // Nodes still open when the search stops count the values they enumerated so far
+    auto finish = [&](chrono::steady_clock::time_point now, TraceOutcome outcome) {
+        if (order[0] >= 0) {
+            for (int d = 0; d <= min(depth, n - 1); d++) st.counters.recordDomain(d, cursors[d].produced);
+        }
+        if (trace) trace->record(run, now, TraceEvent::End, depth, -1, (int)outcome);
+    };
+    if (trace) trace->record(run, chrono::steady_clock::now(), TraceEvent::Begin, 0, n, st.control.traceRequest);
+
+    buildWatchLists(st, variables);
+    st.isAssigned.assign(n, 0);
+    st.domainTrail.clear();
+    st.pruneTrail.clear();
+    st.liveStarts.resize(n);
+    for (int v = 0; v < n; v++) {
+        st.liveStarts[v] = computeLiveStarts(st, variables[v]);
+        if (!st.liveStarts[v]) {
+            st.lastError = "Unable to schedule " + model.getCourse.at(variables[v].courseID).courseName + " (no feasible slot)";
+            st.provedInfeasible = true;
+            finish(chrono::steady_clock::now(), TraceOutcome::Infeasible);
+            return false;
+        }
+    }
+    initVariableOrdering(st, variables);
+    st.pruneSets.assign(n, DepthSet(n));
+    st.conflictSets.assign(n, DepthSet(n));
+    st.varDepth.assign(n, -1);
+    st.assignedValue.resize(n);
+
+    auto descend = [&]() {
+        int v = selectVariable(st);
+        bucketErase(st, v);
+        st.isAssigned[v] = 1;
+        st.varDepth[v] = depth;
+        st.conflictSets[v].clear();
+        order[depth] = v;
+        openDomain(st, variables[v], st.liveStarts[v], cursors[depth]);
+        st.counters.nodes++;
+        if (!st.preferredValue.empty() && st.preferredValue[v].startSlot >= 0 && isValidMove(st, variables[v], st.preferredValue[v])) {
+            preferValue(cursors[depth], st.preferredValue[v]);
+        }
+    };
+    auto unassign = [&](int v) {
+        st.isAssigned[v] = 0;
+        st.varDepth[v] = -1;
+        bucketInsert(st, v);
+    };
+    descend();
+
+    while (depth >= 0 && depth < n) {
+        auto currentTime = chrono::steady_clock::now();
+        // Global timeout check
+        if (chrono::duration_cast<chrono::seconds>(currentTime - st.startTime).count() > ATTEMPT_TIME_LIMIT_S) {
+            st.lastError = "Timeout limit reached.";
+            reportProgress(st, depth);
+            finish(currentTime, TraceOutcome::Timeout);
+            return false;
+        }
+
+        st.iterationCount++;
+        if (st.iterationCount > st.iterationLimit) {
+            st.lastError = "Max iterations reached.";
+            reportProgress(st, depth);
+            finish(currentTime, TraceOutcome::IterationLimit);
+            return false;
+        }
+
+        if (st.iterationCount % PROGRESS_INTERVAL == 0) reportProgress(st, depth);
+
+        if (st.control.abortFlag && st.control.abortFlag->load(memory_order_relaxed)) {
+            st.lastError = "Cancelled by request.";
+            reportProgress(st, depth);
+            finish(currentTime, TraceOutcome::Cancelled);
+            return false;
+        }
+
+        if (st.cancelFlag && st.cancelFlag->load(memory_order_relaxed)) {
+            st.lastError = "Cancelled: another portfolio instance finished first.";
+            reportProgress(st, depth);
+            finish(currentTime, TraceOutcome::Cancelled);
+            return false;
+        }
+
+        bool foundAssignment = false;
+        int v = order[depth];
+        DomainCursor<Mask>& cursor = cursors[depth];
+        CSPValue val;
+
+        while (nextValue(st, variables[v], cursor, val)) {
+            int valueIndex = cursor.produced - 1;
+            if (violatesNogood(st, v, val, st.conflictSets[v])) {
+                st.counters.nogoodRejections++;
+                traceEvent(currentTime, TraceEvent::RejectNogood, v, valueIndex);
+                continue;
+            }
+
+            // The cursor checks each value against the state this depth is restored to on every
+            // backtrack, so the value is valid; forward checking rejects it if it empties some
+            // future variable's domain.
+            applyMove(st, variables[v], val);
+            st.assignedValue[v] = val;
+            trailMarks[depth] = st.domainTrail.size();
+            pruneMarks[depth] = st.pruneTrail.size();
+            int wipedOut = propagateMove(st, variables, v, val, depth);
+            if (wipedOut < 0) {
+                foundAssignment = true;
+                traceEvent(currentTime, TraceEvent::Assign, v, valueIndex);
+                break;
+            }
+            st.counters.forwardCheckRejections++;
+            traceEvent(currentTime, TraceEvent::RejectForward, v, valueIndex);
+            // Whatever emptied the wiped-out domain before this depth is a reason to leave v
+            st.conflictSets[v].unionWith(st.pruneSets[wipedOut]);
+            st.conflictSets[v].reset(depth);
+            restoreDomains(st, trailMarks[depth], pruneMarks[depth], depth);
+            undoMove(st, variables[v], val);
+        }
+
+        if (foundAssignment) {
+            depth++;
+            st.counters.maxDepth = max(st.counters.maxDepth, depth);
+            if (depth < n) descend();
+            continue;
+        }
+
+        // Save error for diagnostics if we fail at root
+        if (depth == 0) {
+            st.lastError = "Unable to schedule " + model.getCourse.at(variables[v].courseID).courseName + " (Root)";
+        }
+        else if (st.lastError == "") {
+            st.lastError = "Unable to schedule " + model.getCourse.at(variables[v].courseID).courseName + " at depth " + to_string(depth);
+        }
+        st.varWeight[v]++;
+        st.counters.backtracks++;
+
+        // Conflict-directed backjump: the values v never got to try were removed by earlier depths
+        st.conflictSets[v].unionWith(st.pruneSets[v]);
+        int target = st.conflictSets[v].highest();
+        traceEvent(currentTime, TraceEvent::Backjump, v, target);
+        if (target < 0) {
+            // No earlier assignment is to blame, so no complete timetable exists
+            st.lastError = "No valid timetable exists: " + model.getCourse.at(variables[v].courseID).courseName + " cannot be placed under any assignment.";
+            st.provedInfeasible = true;
+            reportProgress(st, depth);
+            finish(currentTime, TraceOutcome::Infeasible);
+            return false;
+        }
+        recordNogood(st, st.conflictSets[v], order);
+
+        st.counters.recordDomain(depth, cursor.produced);
+        unassign(v);
+        for (int j = depth - 1; j > target; j--) {
+            int w = order[j];
+            restoreDomains(st, trailMarks[j], pruneMarks[j], j);
+            undoMove(st, variables[w], st.assignedValue[w]);
+            st.counters.recordDomain(j, cursors[j].produced);
+            unassign(w);
+        }
+
+        depth = target;
+        int u = order[depth];
+        restoreDomains(st, trailMarks[depth], pruneMarks[depth], depth);
+        undoMove(st, variables[u], st.assignedValue[u]);
+        st.conflictSets[u].unionWith(st.conflictSets[v]);
+        st.conflictSets[u].reset(depth);
+    }
+
+    reportProgress(st, depth);
+    finish(chrono::steady_clock::now(), TraceOutcome::Solved);
+    return (depth == n);
+}
+
+
+// Seeds an empty board with the fixed variables' values and runs the exact solver on the others
+// within the given iteration budget, trying their entries in `values` first. Failure only means the fixed part cannot be completed, not
+// that no timetable exists; the board is left empty again in that case.
+template <class Mask>
+bool completeAssignment(SolverState<Mask>& st, const vector<CSPVariable>& variables, const vector<CSPValue>& values, const vector<char>& fixed, int iterationBudget) {
+    int priorIterations = st.iterationCount;
+    auto clearBoard = [&]() {
+        resetSimulationState(st);
+        st.iterationCount = priorIterations;
+    };
+    clearBoard();
+
+    vector<CSPVariable> rest;
+    vector<int> restIndex; // Position in `variables` of each entry of `rest`
+    int fixedCount = 0;
+    for (int v = 0; v < (int)variables.size(); v++) {
+        if (fixed[v] && values[v].startSlot >= 0 && isValidMove(st, variables[v], values[v])) {
+            applyMove(st, variables[v], values[v]);
+            fixedCount++;
+        }
+        else {
+            rest.push_back(variables[v]);
+            restIndex.push_back(v);
+        }
+    }
+
+    // Search state is indexed by position in `rest`, so nothing learnt on another list carries over
+    clearNogoods(st);
+    st.varWeight.assign(rest.size(), 1);
+    st.varTieRank.resize(rest.size());
+    for (int v = 0; v < (int)rest.size(); v++) st.varTieRank[v] = v;
+    st.preferredValue.clear();
+    for (int v : restIndex) st.preferredValue.push_back(values[v]);
+    st.fixedVariables = fixedCount;
+    st.iterationCount = 0;
+    st.iterationLimit = iterationBudget;
+
+    bool solved = solveIterative(st, rest);
+
+    st.iterationCount += priorIterations;
+    st.reportedIterations = st.iterationCount;
+    st.iterationLimit = MAX_ITERATIONS;
+    st.fixedVariables = 0;
+    st.preferredValue.clear();
+    st.provedInfeasible = false;
+    if (solved) {
+        // Report the assignment against the full variable list
+        vector<CSPValue> restValues = st.assignedValue;
+        st.assignedValue = values;
+        for (size_t i = 0; i < rest.size(); i++) st.assignedValue[restIndex[i]] = restValues[i];
+    }
+    else {
+        string error = st.lastError;
+        priorIterations = st.iterationCount;
+        clearBoard();
+        st.lastError = error;
+    }
+    return solved;
+}
+
+// --- Local Search ---
+
+const int LS_TABU_TENURE = 10;           // Iterations a (variable, start) pair stays tabu after being left
+const double LS_WALK_PROBABILITY = 0.02; // Chance of a random start instead of the min-conflicts one
+const int LS_STALL_ITERATIONS = 5000;    // Non-improving iterations before handing off to the exact solver
+const int HANDOFF_ITERATIONS = 50000;    // Exact solver budget per handoff
+
+// A complete assignment with clashes allowed. Occupancy is counted per (resource, slot), and
+// busy/clash masks mirror count >= 1 / count >= 2, so every conflict query is a few word operations.
+// Staff unavailability is a permanent occupant of the slot.
+template <class Mask>
+struct LocalSearchState {
+    const ProblemModel* model = nullptr;
+    int slots = 0; // Cells per resource and tabu entries per variable: the grid's slot count
+    vector<CSPValue> values;
+    vector<uint16_t> sectionCount, staffCount, roomCount; // [resource * slots + slot]
+    vector<Mask> sectionBusy, staffBusy, roomBusy;
+    vector<Mask> sectionClash, staffClash, roomClash;
+    vector<int> tabuUntil; // [variable * slots + start]
+    int conflicts = 0;     // Sum over all cells of (count - 1)
+};
+
+// Adds (delta = 1) or removes (delta = -1) one occupant over a resource's window; `row` is the
+// resource's first cell in `count`
+template <class Mask>
+inline void lsOccupy(vector<uint16_t>& count, Mask& busy, Mask& clash, int row, int startSlot, int duration, int delta, int& conflicts) {
+    for (int s = startSlot; s < startSlot + duration; s++) {
+        uint16_t& c = count[row + s];
+        if (delta > 0) conflicts += c >= 1;
+        c += delta;
+        if (delta < 0) conflicts -= c >= 1;
+        Mask bit = Mask(1) << s;
+        busy = c >= 1 ? busy | bit : busy & ~bit;
+        clash = c >= 2 ? clash | bit : clash & ~bit;
+    }
+}
+
+template <class Mask>
+void lsPlace(LocalSearchState<Mask>& ls, const CSPVariable& var, const CSPValue& val, int delta) {
+    for (int secIdx : var.targetSectionIndices) {
+        lsOccupy(ls.sectionCount, ls.sectionBusy[secIdx], ls.sectionClash[secIdx], secIdx * ls.slots, val.startSlot, var.duration, delta, ls.conflicts);
+    }
+    lsOccupy(ls.staffCount, ls.staffBusy[val.staffIdx], ls.staffClash[val.staffIdx], val.staffIdx * ls.slots, val.startSlot, var.duration, delta, ls.conflicts);
+    if (val.roomIdx >= 0) lsOccupy(ls.roomCount, ls.roomBusy[val.roomIdx], ls.roomClash[val.roomIdx], val.roomIdx * ls.slots, val.startSlot, var.duration, delta, ls.conflicts);
+}
+
+template <class Mask>
+bool lsInConflict(const LocalSearchState<Mask>& ls, const CSPVariable& var, const CSPValue& val) {
+    Mask window = slotWindow<Mask>(val.startSlot, var.duration);
+    for (int secIdx : var.targetSectionIndices) if (ls.sectionClash[secIdx] & window) return true;
+    if (ls.staffClash[val.staffIdx] & window) return true;
+    return val.roomIdx >= 0 && (ls.roomClash[val.roomIdx] & window);
+}
+
+// Rebuilds the occupancy from scratch for the given values (unset values have startSlot < 0)
+template <class Mask>
+void lsLoad(LocalSearchState<Mask>& ls, const ProblemModel& model, const vector<CSPVariable>& variables, const vector<CSPValue>& values) {
+    ls.model = &model;
+    ls.slots = model.grid.slots();
+    ls.sectionCount.assign(model.sections.size() * ls.slots, 0);
+    ls.staffCount.assign(model.staffIDs.size() * ls.slots, 0);
+    ls.roomCount.assign(model.rooms.size() * ls.slots, 0);
+    ls.sectionBusy.assign(model.sections.size(), 0);
+    ls.sectionClash.assign(model.sections.size(), 0);
+    ls.staffBusy.resize(model.staffIDs.size());
+    for (size_t s = 0; s < model.staffIDs.size(); s++) ls.staffBusy[s] = narrowMask<Mask>(model.staffUnavailable[s]);
+    ls.staffClash.assign(model.staffIDs.size(), 0);
+    ls.roomBusy.assign(model.rooms.size(), 0);
+    ls.roomClash.assign(model.rooms.size(), 0);
+    ls.conflicts = 0;
+    for (int s = 0; s < (int)model.staffIDs.size(); s++) {
+        for (Mask m = ls.staffBusy[s]; m; m &= m - 1) ls.staffCount[s * ls.slots + lowestBit(m)] = 1;
+    }
+    ls.values = values;
+    for (int v = 0; v < (int)variables.size(); v++) if (values[v].startSlot >= 0) lsPlace(ls, variables[v], values[v], 1);
+}
+
+// Min-conflicts value for variable v while it is lifted off the board. Sections, staff and room
+// add up independently, so each start only needs its least-loaded staff member and room.
+// Tabu starts are skipped unless their cost is below `aspiration`; onlyStart >= 0 fixes the start.
+template <class Mask>
+CSPValue lsBestValue(const LocalSearchState<Mask>& ls, const CSPVariable& var, int v, mt19937& rng, int onlyStart, int iteration, int aspiration) {
+    CSPValue best = { -1, -1, -1 };
+    int bestCost = INT_MAX, ties = 0;
+    Mask starts = onlyStart >= 0 ? Mask(1) << onlyStart : narrowMask<Mask>(ls.model->startsWithinDay[var.duration]);
+    for (; starts; starts &= starts - 1) {
+        int s = lowestBit(starts);
+        Mask window = slotWindow<Mask>(s, var.duration);
+        int cost = 0;
+        for (int secIdx : var.targetSectionIndices) cost += popCount(ls.sectionBusy[secIdx] & window);
+        if (cost > bestCost) continue;
+        if (iteration >= 0 && ls.tabuUntil[v * ls.slots + s] > iteration && cost >= aspiration) continue;
+
+        int staffCost = INT_MAX, staffIdx = -1, staffTies = 0;
+        for (int candidate : var.candidateStaff) {
+            int c = popCount(ls.staffBusy[candidate] & window);
+            if (c < staffCost) { staffCost = c; staffIdx = candidate; staffTies = 1; }
+            else if (c == staffCost && rng() % ++staffTies == 0) staffIdx = candidate;
+        }
+        int roomCost = INT_MAX, roomIdx = -1, roomTies = 0;
+        for (int candidate : var.candidateRooms) {
+            int c = candidate < 0 ? 0 : popCount(ls.roomBusy[candidate] & window);
+            if (c < roomCost) { roomCost = c; roomIdx = candidate; roomTies = 1; }
+            else if (c == roomCost && rng() % ++roomTies == 0) roomIdx = candidate;
+        }
+        cost += staffCost + roomCost;
+        if (iteration >= 0 && ls.tabuUntil[v * ls.slots + s] > iteration && cost >= aspiration) continue;
+
+        if (cost < bestCost) { bestCost = cost; best = { s, staffIdx, roomIdx }; ties = 1; }
+        else if (cost == bestCost && rng() % ++ties == 0) best = { s, staffIdx, roomIdx };
+    }
+    return best;
+}
+
+// Random probes first, then a scan; only called while some variable is in conflict
+template <class Mask>
+int lsPickConflicted(const LocalSearchState<Mask>& ls, const vector<CSPVariable>& variables, mt19937& rng) {
+    int n = variables.size();
+    for (int probe = 0; probe < n; probe++) {
+        int v = rng() % n;
+        if (lsInConflict(ls, variables[v], ls.values[v])) return v;
+    }
+    int offset = rng() % n;
+    for (int k = 0; k < n; k++) {
+        int v = (offset + k) % n;
+        if (lsInConflict(ls, variables[v], ls.values[v])) return v;
+    }
+    return -1;
+}
+
+template <class Mask>
+int lsCountConflicted(const LocalSearchState<Mask>& ls, const vector<CSPVariable>& variables) {
+    int count = 0;
+    for (int v = 0; v < (int)variables.size(); v++) count += lsInConflict(ls, variables[v], ls.values[v]);
+    return count;
+}
+
+// Fixes every variable that is clash-free in the loaded assignment and lets the exact solver
+// place the rest. From the second round on, variables sharing a section, staff member or room
+// with a conflicted one are freed too, so repeated handoffs repair a wider neighbourhood.
+template <class Mask>
+bool handOffToExactSolver(SolverState<Mask>& st, const vector<CSPVariable>& variables, const LocalSearchState<Mask>& ls, int round) {
+    const ProblemModel& model = *st.model;
+    int n = variables.size();
+    vector<char> fixed(n, 1);
+    vector<char> sectionHit(model.sections.size(), 0), staffHit(model.staffIDs.size(), 0), roomHit(model.rooms.size(), 0);
+    for (int v = 0; v < n; v++) {
+        if (!lsInConflict(ls, variables[v], ls.values[v])) continue;
+        fixed[v] = 0;
+        for (int secIdx : variables[v].targetSectionIndices) sectionHit[secIdx] = 1;
+        staffHit[ls.values[v].staffIdx] = 1;
+        if (ls.values[v].roomIdx >= 0) roomHit[ls.values[v].roomIdx] = 1;
+    }
+    if (round > 0) {
+        for (int v = 0; v < n; v++) {
+            bool touches = staffHit[ls.values[v].staffIdx] || (ls.values[v].roomIdx >= 0 && roomHit[ls.values[v].roomIdx]);
+            for (int secIdx : variables[v].targetSectionIndices) touches = touches || sectionHit[secIdx];
+            if (touches) fixed[v] = 0;
+        }
+    }
+    return completeAssignment(st, variables, ls.values, fixed, HANDOFF_ITERATIONS);
+}
+
+// Min-conflicts repair with tabu moves and a small random walk, starting from a greedy
+// assignment. When it stalls, the clash-free part of the best assignment goes to the exact solver.
+// Cannot prove infeasibility; it searches until a timetable is found or the deadline passes.
+template <class Mask>
+bool solveLocalSearch(SolverState<Mask>& st, const vector<CSPVariable>& variables, unsigned seed) {
+    const ProblemModel& model = *st.model;
+    int n = variables.size();
+    st.provedInfeasible = false;
+    st.reportedIterations = st.iterationCount;
+    if (n == 0) return true;
+
+    for (const CSPVariable& var : variables) {
+        if (var.candidateStaff.empty() || var.candidateRooms.empty() || !model.grid.fits(0, var.duration)) {
+            st.lastError = "Unable to schedule " + model.getCourse.at(var.courseID).courseName + " (no feasible slot)";
+            st.provedInfeasible = true;
+            return false;
+        }
+    }
+
+    mt19937 rng(seed);
+    uniform_real_distribution<double> coin(0.0, 1.0);
+    LocalSearchState<Mask> ls;
+    lsLoad(ls, model, variables, vector<CSPValue>(n, CSPValue{ -1, -1, -1 }));
+    ls.tabuUntil.assign(n * ls.slots, 0);
+
+    // Greedy start in tie-break order
+    vector<int> byRank(n);
+    for (int v = 0; v < n; v++) byRank[v] = v;
+    sort(byRank.begin(), byRank.end(), [&](int a, int b) { return st.varTieRank[a] < st.varTieRank[b]; });
+    for (int v : byRank) {
+        ls.values[v] = lsBestValue(ls, variables[v], v, rng, -1, -1, 0);
+        lsPlace(ls, variables[v], ls.values[v], 1);
+    }
+
+    vector<CSPValue> best = ls.values;
+    int bestConflicts = ls.conflicts;
+    int bestConflicted = lsCountConflicted(ls, variables);
+    int stall = 0, handoffs = 0;
+
+    while (ls.conflicts > 0) {
+        if (st.iterationCount % PROGRESS_INTERVAL == 0) {
+            reportProgress(st, n - bestConflicted);
+            string stopReason;
+            if (chrono::duration_cast<chrono::seconds>(chrono::steady_clock::now() - st.startTime).count() > ATTEMPT_TIME_LIMIT_S) stopReason = "Timeout limit reached.";
+            else if (st.control.abortFlag && st.control.abortFlag->load(memory_order_relaxed)) stopReason = "Cancelled by request.";
+            else if (st.cancelFlag && st.cancelFlag->load(memory_order_relaxed)) stopReason = "Cancelled: another portfolio instance finished first.";
+            if (!stopReason.empty()) {
+                st.lastError = stopReason + " Local search left " + to_string(bestConflicted) + " conflicting classes.";
+                return false;
+            }
+        }
+        st.iterationCount++;
+
+        if (stall >= LS_STALL_ITERATIONS) {
+            stall = 0;
+            lsLoad(ls, model, variables, best);
+            if (handOffToExactSolver(st, variables, ls, handoffs++)) {
+                reportProgress(st, n);
+                return true;
+            }
+            continue;
+        }
+
+        int v = lsPickConflicted(ls, variables, rng);
+        const CSPVariable& var = variables[v];
+        CSPValue old = ls.values[v];
+        lsPlace(ls, var, old, -1);
+        ls.tabuUntil[v * ls.slots + old.startSlot] = st.iterationCount + LS_TABU_TENURE;
+
+        // A move that beats the best assignment is taken even when tabu
+        int aspiration = bestConflicts - ls.conflicts;
+        int onlyStart = -1;
+        if (coin(rng) < LS_WALK_PROBABILITY) {
+            int day = rng() % model.grid.days;
+            onlyStart = day * model.grid.periodsPerDay + (int)(rng() % (model.grid.periodsPerDay - var.duration + 1));
+        }
+        CSPValue next = lsBestValue(ls, var, v, rng, onlyStart, st.iterationCount, aspiration);
+        if (next.startSlot < 0) next = old;
+        ls.values[v] = next;
+        lsPlace(ls, var, next, 1);
+        st.counters.nodes++;
+
+        if (ls.conflicts < bestConflicts) {
+            best = ls.values;
+            bestConflicts = ls.conflicts;
+            bestConflicted = lsCountConflicted(ls, variables);
+            stall = 0;
+        }
+        else stall++;
+    }
+
+    // Clash-free: every value is valid, write the assignment to the board
+    for (int v = 0; v < n; v++) applyMove(st, variables[v], ls.values[v]);
+    st.assignedValue = ls.values;
+    reportProgress(st, n);
+    return true;
+}
+
+// --- SAT Backend ---
+
+// Encodes placing the variables on the current board as CNF. Per variable: exactly one of its
+// live starts x, one staff member y and one room z (none when it needs no room), plus cover
+// literals c that hold for each period its class runs (x itself for one-period classes).
+// A section takes at most one class per period, over the cover literals; a staff member or room
+// likewise, over auxiliaries u <- c & y (c & z). Periods a resource is busy exclude c & y outright.
+// Cover literals and u only ever get implied, so the solver branches on the choices alone.
+template <class Mask>
+SatEncoding encodeSat(const SolverState<Mask>& st, const vector<CSPVariable>& variables) {
+    const ProblemModel& model = *st.model;
+    int n = variables.size(), slots = model.grid.slots();
+    SatEncoding enc;
+    CnfFormula& f = enc.formula;
+    enc.starts.resize(n);
+    enc.staff.resize(n);
+    enc.rooms.resize(n);
+    enc.startVar.assign(n, 0);
+    enc.staffVar.assign(n, 0);
+    enc.roomVar.assign(n, 0);
+    vector<vector<int>> cover(n); // cover[v][p]: literal of v's class running in period p, 0 if it cannot
+    vector<vector<int>> bySection(model.sections.size());
+    vector<vector<pair<int, int>>> byStaff(model.staffIDs.size()), byRoom(model.rooms.size()); // (variable, y or z)
+    vector<int> group;
+
+    for (int v = 0; v < n; v++) {
+        const CSPVariable& var = variables[v];
+        Mask starts = computeLiveStarts(st, var);
+        if (!starts) {
+            enc.unschedulable = v;
+            return enc;
+        }
+        Mask fits = narrowMask<Mask>(model.startsWithinDay[var.duration]);
+        for (Mask m = starts; m; m &= m - 1) enc.starts[v].push_back(lowestBit(m));
+        for (int staffIdx : var.candidateStaff) {
+            if (freeStarts(st.staffBusy[staffIdx], var.duration, fits) & starts) enc.staff[v].push_back(staffIdx);
+        }
+        for (int roomIdx : var.candidateRooms) {
+            if (roomIdx >= 0 && (freeStarts(st.roomBusy[roomIdx], var.duration, fits) & starts)) enc.rooms[v].push_back(roomIdx);
+        }
+
+        // Each choice's variables are allocated in one run, before any auxiliaries of its constraint
+        auto choose = [&](const vector<int>& options, int& first) {
+            first = f.variables + 1;
+            group.clear();
+            for (size_t i = 0; i < options.size(); i++) group.push_back(f.newVariable());
+            f.exactlyOne(group);
+        };
+        choose(enc.starts[v], enc.startVar[v]);
+        choose(enc.staff[v], enc.staffVar[v]);
+        if (!enc.rooms[v].empty()) choose(enc.rooms[v], enc.roomVar[v]);
+
+        cover[v].assign(slots, 0);
+        for (size_t i = 0; i < enc.starts[v].size(); i++) {
+            int x = enc.startVar[v] + i;
+            for (int p = enc.starts[v][i]; p < enc.starts[v][i] + var.duration; p++) {
+                if (var.duration == 1) {
+                    cover[v][p] = x;
+                    continue;
+                }
+                if (!cover[v][p]) cover[v][p] = f.newVariable(true);
+                f.addClause({ -x, cover[v][p] });
+            }
+        }
+
+        for (int secIdx : var.targetSectionIndices) bySection[secIdx].push_back(v);
+        for (size_t i = 0; i < enc.staff[v].size(); i++) byStaff[enc.staff[v][i]].push_back({ v, enc.staffVar[v] + (int)i });
+        for (size_t i = 0; i < enc.rooms[v].size(); i++) byRoom[enc.rooms[v][i]].push_back({ v, enc.roomVar[v] + (int)i });
+    }
+
+    for (const vector<int>& users : bySection) {
+        if (users.size() < 2) continue;
+        for (int p = 0; p < slots; p++) {
+            group.clear();
+            for (int v : users) if (cover[v][p]) group.push_back(cover[v][p]);
+            if (group.size() > 1) f.atMostOne(group);
+        }
+    }
+
+    // A variable with a single option has that choice forced, so its cover literal stands in for u
+    vector<int> occupied;
+    auto resourceClauses = [&](const vector<pair<int, int>>& users, Mask busy, const vector<vector<int>>& options) {
+        for (int p = 0; p < slots; p++) {
+            bool isBusy = (bool)(busy & (Mask(1) << p));
+            int running = 0;
+            for (const pair<int, int>& user : users) {
+                int c = cover[user.first][p];
+                if (!c) continue;
+                if (isBusy) f.addClause({ -c, -user.second });
+                running++;
+            }
+            if (isBusy || running < 2) continue;
+            occupied.clear();
+            for (const pair<int, int>& user : users) {
+                int c = cover[user.first][p];
+                if (!c) continue;
+                if (options[user.first].size() == 1) {
+                    occupied.push_back(c);
+                    continue;
+                }
+                int u = f.newVariable(true);
+                f.addClause({ -c, -user.second, u });
+                occupied.push_back(u);
+            }
+            f.atMostOne(occupied);
+        }
+    };
+    for (size_t t = 0; t < byStaff.size(); t++) {
+        if (!byStaff[t].empty()) resourceClauses(byStaff[t], st.staffBusy[t], enc.staff);
+    }
+    for (size_t r = 0; r < byRoom.size(); r++) {
+        if (!byRoom[r].empty()) resourceClauses(byRoom[r], st.roomBusy[r], enc.rooms);
+    }
+    return enc;
+}
+
+// The variable's value in a model of the encoding: its first true start, staff and room choice
+CSPValue decodeSat(const SatEncoding& enc, const SatSolver& solver, int v) {
+    auto chosen = [&](const vector<int>& options, int first) {
+        for (size_t i = 0; i < options.size(); i++) if (solver.value(first + i)) return options[i];
+        return -1;
+    };
+    int roomIdx = enc.rooms[v].empty() ? -1 : chosen(enc.rooms[v], enc.roomVar[v]);
+    return { chosen(enc.starts[v], enc.startVar[v]), chosen(enc.staff[v], enc.staffVar[v]), roomIdx };
+}
+
+// Places the variables by handing their CNF encoding to the embedded SAT solver. Complete like
+// the backtracker: unsatisfiability proves that no timetable exists. Iterations count conflicts.
+template <class Mask>
+bool solveSat(SolverState<Mask>& st, const vector<CSPVariable>& variables, unsigned seed) {
+    const ProblemModel& model = *st.model;
+    int n = variables.size();
+    st.provedInfeasible = false;
+    st.reportedIterations = st.iterationCount;
+    st.assignedValue.resize(n);
+    if (n == 0) return true;
+
+    SatEncoding enc = encodeSat(st, variables);
+    if (enc.unschedulable >= 0) {
+        st.lastError = "Unable to schedule " + model.getCourse.at(variables[enc.unschedulable].courseID).courseName + " (no feasible slot)";
+        st.provedInfeasible = true;
+        return false;
+    }
+    st.counters.satVariables += enc.formula.variables;
+    st.counters.satClauses += enc.formula.clauses;
+    SatSolver solver(enc.formula, seed);
+    enc.formula = CnfFormula(); // The solver keeps its own copy of the clauses
+
+    int priorIterations = st.iterationCount;
+    string stopReason;
+    auto checkpoint = [&]() {
+        st.iterationCount = priorIterations + (int)solver.stats().conflicts;
+        int placed = 0;
+        for (int v = 0; v < n; v++) {
+            for (size_t i = 0; i < enc.starts[v].size(); i++) {
+                if (solver.value(enc.startVar[v] + i)) {
+                    placed++;
+                    break;
+                }
+            }
+        }
+        reportProgress(st, placed);
+        if (chrono::duration_cast<chrono::seconds>(chrono::steady_clock::now() - st.startTime).count() > ATTEMPT_TIME_LIMIT_S) stopReason = "Timeout limit reached.";
+        else if (st.control.abortFlag && st.control.abortFlag->load(memory_order_relaxed)) stopReason = "Cancelled by request.";
+        else if (st.cancelFlag && st.cancelFlag->load(memory_order_relaxed)) stopReason = "Cancelled: another portfolio instance finished first.";
+        return stopReason.empty();
+    };
+    SatResult result = solver.solve(st.iterationLimit - priorIterations, checkpoint);
+
+    const SatStats& stats = solver.stats();
+    st.iterationCount = priorIterations + (int)stats.conflicts;
+    st.counters.satConflicts += stats.conflicts;
+    st.counters.satDecisions += stats.decisions;
+    st.counters.satPropagations += stats.propagations;
+    if (result == SatResult::Unsatisfiable) {
+        st.lastError = "No valid timetable exists: the SAT encoding of the " + to_string(n) + " classes is unsatisfiable.";
+        st.provedInfeasible = true;
+        reportProgress(st, 0);
+        return false;
+    }
+    if (result == SatResult::Unknown) {
+        st.lastError = stopReason.empty() ? "Max iterations reached." : stopReason;
+        reportProgress(st, 0);
+        return false;
+    }
+
+    for (int v = 0; v < n; v++) {
+        CSPValue val = decodeSat(enc, solver, v);
+        if (!isValidMove(st, variables[v], val)) {
+            st.lastError = "SAT model places " + model.getCourse.at(variables[v].courseID).courseName + " on a clash.";
+            for (int w = 0; w < v; w++) undoMove(st, variables[w], st.assignedValue[w]);
+            return false;
+        }
+        applyMove(st, variables[v], val);
+        st.assignedValue[v] = val;
+    }
+    st.counters.nodes += n;
+    st.counters.maxDepth = max(st.counters.maxDepth, n);
+    reportProgress(st, n);
+    return true;
+}
+
+// Backtracking first, as it settles most requests well within a fraction of its budget; once it
+// stalls on the iteration limit, the SAT backend takes over with the rest of the attempt
+template <class Mask>
+bool solveAuto(SolverState<Mask>& st, const vector<CSPVariable>& variables, unsigned seed) {
+    int limit = st.iterationLimit;
+    int budget = min(limit, AUTO_STALL_ITERATIONS);
+    st.iterationLimit = budget;
+    bool solved = solveIterative(st, variables);
+    st.iterationLimit = limit;
+    // Solved, proved infeasible, timed out, cancelled, or without iterations left to hand over
+    if (solved || st.iterationCount <= budget || budget == limit) return solved;
+
+    cout << "Backtracking stalled after " << budget << " iterations. Handing off to the SAT backend..." << endl;
+    int iterations = st.iterationCount;
+    resetSimulationState(st); // Clears the partial assignment the search stopped on
+    st.iterationCount = iterations;
+    return solveSat(st, variables, seed);
+}
+
+// --- Optimization ---
+
+const int LNS_MAX_FREED = 12; // Classes re-placed per neighbourhood
+
+// Anytime improvement of a complete timetable until the deadline. Each step frees a neighbourhood
+// (a section's day, a staff member's day, or random classes), re-places it greedily by objective
+// delta within the live domains, and keeps the result unless the objective got worse.
+// Expects st.assignedValue to hold the board's assignment; returns the number of improving steps.
+template <class Mask>
+int improveTimetable(SolverState<Mask>& st, const vector<CSPVariable>& variables, chrono::steady_clock::time_point deadline, unsigned seed) {
+    int n = variables.size();
+    if (n == 0) return 0;
+    mt19937 rng(seed);
+    int periods = st.model->grid.periodsPerDay;
+    st.objective = weightedObjective(st.model->weights, evaluateObjective(st, variables));
+    st.trackObjective = true;
+
+    vector<int> freed;
+    vector<CSPValue> previous;
+    DomainCursor<Mask> cursor;
+    int improvements = 0;
+
+    for (int step = 0; chrono::steady_clock::now() < deadline; step++) {
+        if (st.control.abortFlag && st.control.abortFlag->load(memory_order_relaxed)) break;
+
+        // Choose the neighbourhood around a random class
+        int seedVar = rng() % n;
+        const CSPValue& seedVal = st.assignedValue[seedVar];
+        int day = seedVal.startSlot / periods;
+        int kind = rng() % 3;
+        freed.clear();
+        for (int k = 0; k < n && (int)freed.size() < LNS_MAX_FREED; k++) {
+            int v = (seedVar + k) % n;
+            const CSPValue& val = st.assignedValue[v];
+            bool pick;
+            if (kind == 0) {
+                pick = val.startSlot / periods == day && any_of(variables[v].targetSectionIndices.begin(), variables[v].targetSectionIndices.end(),
+                    [&](int secIdx) { return secIdx == variables[seedVar].targetSectionIndices[0]; });
+            }
+            else if (kind == 1) pick = val.startSlot / periods == day && val.staffIdx == seedVal.staffIdx;
+            else pick = k == 0 || rng() % max(1, n / LNS_MAX_FREED) == 0;
+            if (pick) freed.push_back(v);
+        }
+        shuffle(freed.begin(), freed.end(), rng);
+
+        long long before = st.objective;
+        previous.clear();
+        for (int v : freed) {
+            previous.push_back(st.assignedValue[v]);
+            undoMove(st, variables[v], st.assignedValue[v]);
+        }
+
+        // Greedy re-placement by objective delta, ties broken at random
+        size_t placed = 0;
+        for (; placed < freed.size(); placed++) {
+            int v = freed[placed];
+            openDomain(st, variables[v], computeLiveStarts(st, variables[v]), cursor);
+            long long bestDelta = LLONG_MAX;
+            int ties = 0;
+            CSPValue val, chosen;
+            while (nextValue(st, variables[v], cursor, val)) {
+                long long delta = moveDelta(st, variables[v], val);
+                if (delta < bestDelta) { bestDelta = delta; chosen = val; ties = 1; }
+                else if (delta == bestDelta && rng() % ++ties == 0) chosen = val;
+            }
+            if (!cursor.produced) break;
+            applyMove(st, variables[v], chosen);
+            st.assignedValue[v] = chosen;
+        }
+
+        bool keep = placed == freed.size() && st.objective <= before;
+        if (!keep) {
+            for (size_t i = 0; i < placed; i++) undoMove(st, variables[freed[i]], st.assignedValue[freed[i]]);
+            for (size_t i = 0; i < freed.size(); i++) {
+                applyMove(st, variables[freed[i]], previous[i]);
+                st.assignedValue[freed[i]] = previous[i];
+            }
+        }
+        else if (st.objective < before) improvements++;
+        st.iterationCount++;
+    }
+
+    st.trackObjective = false;
+    return improvements;
+}
+
+// --- Portfolio ---
+
+// Strategy i of a portfolio: the requested ordering, plain MRV, then reseeded dom/wdeg variants.
+// Local search and SAT portfolios race differently seeded runs instead. An auto portfolio races
+// the SAT backend against the backtracking members rather than waiting for them to stall.
+SolverStrategy portfolioStrategy(int i, VariableOrdering requested, unsigned baseSeed, SolverEngine engine) {
+    if (engine == SolverEngine::LocalSearch || engine == SolverEngine::Sat) {
+        unsigned seed = i == 0 ? 0 : baseSeed + i;
+        string name = solverEngineName(engine);
+        return { i == 0 ? name : name + "#" + to_string(seed), requested, seed, engine };
+    }
+    if (engine == SolverEngine::Auto) {
+        if (i == 0) return { "auto", requested, 0, engine };
+        if (i == 1) return { "sat", requested, 0, SolverEngine::Sat };
+        return portfolioStrategy(i - 1, requested, baseSeed, SolverEngine::Backtrack);
+    }
+    if (i == 0) return { "primary", requested, 0 };
+    if (i == 1) return { "mrv", VariableOrdering::MRV, 0 };
+    unsigned seed = baseSeed + i;
+    return { "domwdeg#" + to_string(seed), VariableOrdering::DomWdeg, seed };
+}
+
+// One solver instance: fresh state, tie-breaks reseeded when the strategy asks for it
+template <class Mask>
+bool runStrategy(SolverState<Mask>& st, const ProblemModel& model, const vector<CSPVariable>& variables, const SolverStrategy& strategy, const atomic<bool>* cancelFlag, const SolveControl& control) {
+    st.model = &model;
+    resetSimulationState(st);
+    clearNogoods(st);
+    st.variableOrdering = strategy.ordering;
+    st.varWeight.assign(variables.size(), 1);
+    st.varTieRank.resize(variables.size());
+    for (int v = 0; v < (int)variables.size(); v++) st.varTieRank[v] = v;
+    if (strategy.seed) {
+        mt19937 g(strategy.seed);
+        shuffle(st.varTieRank.begin(), st.varTieRank.end(), g);
+    }
+    st.cancelFlag = cancelFlag;
+    st.control = control;
+    if (control.progress) control.progress->attempts++;
+    st.startTime = chrono::steady_clock::now() - control.timeSpent;
+    if (strategy.engine == SolverEngine::LocalSearch) return solveLocalSearch(st, variables, strategy.seed);
+    if (strategy.engine == SolverEngine::Sat) return solveSat(st, variables, strategy.seed);
+    if (strategy.engine == SolverEngine::Auto) return solveAuto(st, variables, strategy.seed);
+    return solveIterative(st, variables);
+}
+
+// Serial mode: one instance, retried with reseeded tie-breaks. Weights and nogoods carry over.
+// Local search already spends the whole time limit and the SAT backend (which auto ends in) is
+// complete, so those run once.
+template <class Mask>
+SolveOutcome<Mask> solveWithRetries(const ProblemModel& model, const vector<CSPVariable>& variables, VariableOrdering ordering, SolverEngine engine, const SolveControl& control) {
+    SolveOutcome<Mask> outcome;
+    SolverState<Mask>& st = outcome.state;
+    SolverStrategy primary = portfolioStrategy(0, ordering, 0, engine);
+    outcome.strategy = primary.name;
+    outcome.success = runStrategy(st, model, variables, primary, nullptr, control);
+    outcome.attempts = 1;
+
+    std::mt19937 g(solveSeed(control));
+
+    auto aborted = [&]() { return control.abortFlag && control.abortFlag->load(); };
+    while (engine == SolverEngine::Backtrack && !outcome.success && !st.provedInfeasible && !aborted() && outcome.attempts <= MAX_RETRIES) {
+        cout << "Solution attempt " << outcome.attempts << " failed. Reseeding tie-breaks and retrying..." << endl;
+
+        resetSimulationState(st); // Clear the board
+
+        // Keep the dom/wdeg weights learnt so far (they carry the failure history)
+        // and only reshuffle the final tie-breaker to steer into a different tree.
+        std::shuffle(st.varTieRank.begin(), st.varTieRank.end(), g);
+
+        st.startTime = chrono::steady_clock::now(); // Reset timer for the new attempt
+        if (control.progress) control.progress->attempts++;
+        outcome.success = solveIterative(st, variables);
+        outcome.strategy = "retry#" + to_string(outcome.attempts);
+        outcome.attempts++;
+    }
+    outcome.counters = st.counters;
+    return outcome;
+}
+
+// Portfolio mode: differently ordered/seeded instances race on the pool, `threads` at a time.
+// The first solution (or infeasibility proof) cancels the others cooperatively.
+template <class Mask>
+SolveOutcome<Mask> solvePortfolio(WorkerPool& pool, const ProblemModel& model, const vector<CSPVariable>& variables, VariableOrdering ordering, SolverEngine engine, int threads, const SolveControl& control) {
+    int members = engine == SolverEngine::LocalSearch || engine == SolverEngine::Sat ? threads
+        : max(threads, (engine == SolverEngine::Auto ? 2 : 1) + MAX_RETRIES);
+    vector<SolverState<Mask>> states(members);
+    vector<char> started(members, 0);
+    atomic<bool> stop(false);
+    atomic<int> nextMember(0);
+    mutex winnerMutex;
+    int winner = -1;
+    unsigned baseSeed = solveSeed(control);
+
+    auto worker = [&]() {
+        while (!stop.load() && !(control.abortFlag && control.abortFlag->load())) {
+            int i = nextMember++;
+            if (i >= members) return;
+            started[i] = 1;
+            SolverStrategy strategy = portfolioStrategy(i, ordering, baseSeed, engine);
+            bool solved = runStrategy(states[i], model, variables, strategy, &stop, control);
+            if (solved || states[i].provedInfeasible) {
+                lock_guard<mutex> lock(winnerMutex);
+                if (winner < 0) winner = i;
+                stop = true;
+            }
+        }
+    };
+
+    vector<future<void>> running;
+    for (int t = 0; t < threads; t++) running.push_back(pool.submit(worker));
+    for (auto& f : running) f.get();
+
+    SolveOutcome<Mask> outcome;
+    for (int i = 0; i < members; i++) {
+        outcome.attempts += started[i];
+        outcome.counters.merge(states[i].counters);
+    }
+    int chosen = winner >= 0 ? winner : 0;
+    outcome.success = winner >= 0 && !states[winner].provedInfeasible;
+    outcome.strategy = portfolioStrategy(chosen, ordering, baseSeed, engine).name;
+    outcome.state = move(states[chosen]);
+    return outcome;
+}
+
+// --- Decomposition ---
+
+// Groups the variables into components joined by a shared section or candidate staff member,
+// and by a candidate room too when `throughRooms` is set; with rooms, no constraint crosses two
+// components. Components are listed largest first, holding variable positions in their original order.
+vector<vector<int>> independentComponents(const ProblemModel& model, const vector<CSPVariable>& variables, bool throughRooms) {
+    int n = variables.size();
+    vector<int> parent(n);
+    for (int v = 0; v < n; v++) parent[v] = v;
+    auto find = [&](int v) {
+        while (parent[v] != v) v = parent[v] = parent[parent[v]];
+        return v;
+    };
+    // Every resource remembers the first variable that touches it; later ones join its set
+    auto link = [&](vector<int>& owner, int resource, int v) {
+        if (owner[resource] < 0) { owner[resource] = v; return; }
+        int a = find(owner[resource]), b = find(v);
+        if (a != b) parent[max(a, b)] = min(a, b);
+    };
+
+    vector<int> sectionOwner(model.sections.size(), -1), staffOwner(model.staffIDs.size(), -1), roomOwner(model.rooms.size(), -1);
+    for (int v = 0; v < n; v++) {
+        for (int sec : variables[v].targetSectionIndices) link(sectionOwner, sec, v);
+        for (int staff : variables[v].candidateStaff) link(staffOwner, staff, v);
+        if (!throughRooms) continue;
+        for (int room : variables[v].candidateRooms) {
+            if (room >= 0) link(roomOwner, room, v);
+        }
+    }
+
+    vector<vector<int>> components;
+    vector<int> componentOf(n, -1);
+    for (int v = 0; v < n; v++) {
+        int root = find(v);
+        if (componentOf[root] < 0) {
+            componentOf[root] = components.size();
+            components.emplace_back();
+        }
+        components[componentOf[root]].push_back(v);
+    }
+    stable_sort(components.begin(), components.end(), [](const vector<int>& a, const vector<int>& b) { return a.size() > b.size(); });
+    return components;
+}
+
+// Hands every room to a single component, so components that only met in shared rooms become
+// independent. First each class, fewest candidates first, gets one room in its component (the
+// least contested free one). The remaining rooms then go, least contested first, to the component
+// that wants them most, discounted by how much of its demand for that kind of room (type and lab
+// type) the rooms it already holds cover. Fills `subproblems` with each component's variables
+// restricted to its rooms; false when a class is left without one. The split can lose
+// solutions, so a failed component proves nothing.
+bool partitionRooms(const ProblemModel& model, const vector<CSPVariable>& variables, const vector<vector<int>>& components, vector<vector<CSPVariable>>& subproblems) {
+    int count = components.size(), rooms = model.rooms.size(), kinds = model.roomsByKind.size();
+    vector<int> roomKind(rooms, 0);
+    int kind = 0;
+    for (auto& entry : model.roomsByKind) {
+        for (int r : entry.second) roomKind[r] = kind;
+        kind++;
+    }
+
+    // load[c][r]: periods of component c that could use room r, each class spread evenly over
+    // its candidates; demand[c][k]: periods of component c that need a room of kind k
+    vector<vector<double>> load(count, vector<double>(rooms, 0)), demand(count, vector<double>(kinds, 0));
+    vector<double> kindDemand(kinds, 0), kindSupply(kinds, 0);
+    vector<int> componentOf(variables.size()), byCandidates;
+    for (int c = 0; c < count; c++) {
+        for (int v : components[c]) {
+            const CSPVariable& var = variables[v];
+            componentOf[v] = c;
+            if (var.candidateRooms.empty() || var.candidateRooms[0] < 0) continue;
+            for (int r : var.candidateRooms) load[c][r] += (double)var.duration / var.candidateRooms.size();
+            demand[c][roomKind[var.candidateRooms[0]]] += var.duration;
+            kindDemand[roomKind[var.candidateRooms[0]]] += var.duration;
+            byCandidates.push_back(v);
+        }
+    }
+    for (int r = 0; r < rooms; r++) kindSupply[roomKind[r]] += model.grid.slots();
+
+    vector<int> order(rooms), wanting(rooms, 0);
+    for (int r = 0; r < rooms; r++) {
+        order[r] = r;
+        for (int c = 0; c < count; c++) wanting[r] += load[c][r] > 0;
+    }
+    stable_sort(order.begin(), order.end(), [&](int a, int b) { return wanting[a] < wanting[b]; });
+
+    // granted[c][k]: periods of kind k rooms held, scaled by how full rooms of that kind run overall
+    vector<int> owner(rooms, -1);
+    vector<vector<double>> granted(count, vector<double>(kinds, 0));
+    auto grant = [&](int r, int c) {
+        owner[r] = c;
+        granted[c][roomKind[r]] += model.grid.slots() * kindDemand[roomKind[r]] / kindSupply[roomKind[r]];
+    };
+
+    stable_sort(byCandidates.begin(), byCandidates.end(), [&](int a, int b) { return variables[a].candidateRooms.size() < variables[b].candidateRooms.size(); });
+    for (int v : byCandidates) {
+        int c = componentOf[v], claim = -1;
+        bool covered = false;
+        for (int r : variables[v].candidateRooms) {
+            covered = covered || owner[r] == c;
+            if (owner[r] < 0 && (claim < 0 || wanting[r] < wanting[claim])) claim = r;
+        }
+        if (covered) continue;
+        if (claim < 0) return false;
+        grant(claim, c);
+    }
+
+    for (int r : order) {
+        if (owner[r] >= 0) continue;
+        int k = roomKind[r], best = -1;
+        double bestScore = 0;
+        for (int c = 0; c < count; c++) {
+            if (load[c][r] <= 0) continue;
+            double uncovered = max(0.0, 1 - granted[c][k] / demand[c][k]);
+            double score = load[c][r] * (uncovered + 1e-6);
+            if (score > bestScore) {
+                bestScore = score;
+                best = c;
+            }
+        }
+        if (best >= 0) grant(r, best);
+    }
+
+    subproblems.assign(count, {});
+    for (int c = 0; c < count; c++) {
+        for (int v : components[c]) {
+            CSPVariable var = variables[v];
+            if (!var.candidateRooms.empty() && var.candidateRooms[0] >= 0) {
+                var.candidateRooms.erase(remove_if(var.candidateRooms.begin(), var.candidateRooms.end(), [&](int r) { return owner[r] != c; }), var.candidateRooms.end());
+            }
+            subproblems[c].push_back(move(var));
+        }
+    }
+    return true;
+}
+
+// Decomposed mode. Independent components are serial solves of their own (retries included),
+// run concurrently on the pool whatever `threads` is, and merged onto one board; a failure names
+// its component. When only shared rooms tie the sections and staff together, the rooms are split
+// between the clusters (partitionRooms()) and every cluster gets a single attempt, all of them
+// within ROOM_SPLIT_TIME_LIMIT_MS. If one of them fails the others are cancelled and the problem
+// is solved jointly, as it is when nothing splits, with the time the split took off its limit.
+// `threads` is the portfolio size of the joint solve.
+template <class Mask>
+SolveOutcome<Mask> solveDecomposed(WorkerPool& pool, const ProblemModel& model, const vector<CSPVariable>& variables, VariableOrdering ordering, SolverEngine engine, int threads, const SolveControl& control) {
+    auto start = chrono::steady_clock::now();
+    auto solveJointly = [&](const SolveControl& jointControl) {
+        return threads > 1
+            ? solvePortfolio<Mask>(pool, model, variables, ordering, engine, threads, jointControl)
+            : solveWithRetries<Mask>(model, variables, ordering, engine, jointControl);
+    };
+
+    vector<vector<int>> components = independentComponents(model, variables, true);
+    vector<vector<CSPVariable>> subproblems;
+    bool roomSplit = components.size() <= 1;
+    if (roomSplit) {
+        components = independentComponents(model, variables, false);
+        if (components.size() <= 1 || !partitionRooms(model, variables, components, subproblems)) return solveJointly(control);
+    }
+    else {
+        subproblems.resize(components.size());
+        for (size_t c = 0; c < components.size(); c++) {
+            for (int v : components[c]) subproblems[c].push_back(variables[v]);
+        }
+    }
+
+    // The largest components come first, so the longest solves start earliest
+    int count = components.size();
+    vector<SolveOutcome<Mask>> parts(count);
+    atomic<bool> stop(false);
+    atomic<int> nextComponent(0);
+    auto worker = [&]() {
+        while (!stop.load() && !(control.abortFlag && control.abortFlag->load())) {
+            int c = nextComponent++;
+            if (c >= count) return;
+            SolveOutcome<Mask>& part = parts[c];
+            if (!roomSplit) {
+                part = solveWithRetries<Mask>(model, subproblems[c], ordering, engine, control);
+                continue;
+            }
+            SolverStrategy primary = portfolioStrategy(0, ordering, 0, engine);
+            part.state.iterationLimit = ROOM_SPLIT_ITERATIONS;
+            part.success = runStrategy(part.state, model, subproblems[c], primary, &stop, control);
+            part.strategy = primary.name;
+            part.attempts = 1;
+            part.counters = part.state.counters;
+            if (!part.success) stop = true;
+        }
+    };
+    vector<future<void>> running;
+    for (int t = 0; t < min(pool.size(), count); t++) running.push_back(pool.submit(worker));
+    auto splitDeadline = start + chrono::milliseconds(ROOM_SPLIT_TIME_LIMIT_MS);
+    bool splitTimedOut = false;
+    for (auto& f : running) {
+        if (roomSplit && f.wait_until(splitDeadline) == future_status::timeout) {
+            splitTimedOut = true;
+            stop = true; // Cancels the clusters still running and skips those not started
+        }
+        f.get();
+    }
+
+    SolveOutcome<Mask> outcome;
+    SolverState<Mask>& st = outcome.state;
+    st.model = &model;
+    st.control = control;
+    resetSimulationState(st);
+    st.assignedValue.assign(variables.size(), CSPValue{ -1, -1, -1 });
+    outcome.strategy = roomSplit ? "room-split" : "components";
+    outcome.components = count;
+    int failed = 0;
+    for (int c = 0; c < count; c++) {
+        SolveOutcome<Mask>& part = parts[c];
+        outcome.attempts += part.attempts;
+        outcome.counters.merge(part.counters);
+        st.iterationCount += part.state.iterationCount;
+        if (!part.success) {
+            if (failed++ == 0) {
+                st.lastError = "Component " + to_string(c + 1) + " of " + to_string(count) + " (" + to_string(components[c].size()) + " classes): "
+                    + (part.state.lastError.empty() ? "not solved" : part.state.lastError);
+            }
+            st.provedInfeasible = st.provedInfeasible || part.state.provedInfeasible;
+            continue;
+        }
+        for (size_t i = 0; i < components[c].size(); i++) {
+            int v = components[c][i];
+            st.assignedValue[v] = part.state.assignedValue[i];
+            applyMove(st, variables[v], st.assignedValue[v]);
+        }
+    }
+    outcome.success = failed == 0;
+    if (failed > 1 && !roomSplit) st.lastError += " (" + to_string(failed - 1) + " more components failed)";
+
+    if (roomSplit && !outcome.success && !(control.abortFlag && control.abortFlag->load())) {
+        if (splitTimedOut) cout << "Room split ran out of time. Solving jointly..." << endl;
+        else cout << "Room split failed (" << st.lastError << "). Solving jointly..." << endl;
+        SolveControl jointControl = control;
+        jointControl.timeSpent += chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start);
+        SolveOutcome<Mask> joint = solveJointly(jointControl);
+        joint.attempts += outcome.attempts;
+        joint.counters.merge(outcome.counters);
+        return joint;
+    }
+    return outcome;
+}
+
+// --- Statistics ---
+
+void SolverCounters::merge(const SolverCounters& o) {
+    iterations += o.iterations;
+    nodes += o.nodes;
+    backtracks += o.backtracks;
+    maxDepth = max(maxDepth, o.maxDepth);
+    nogoodRejections += o.nogoodRejections;
+    forwardCheckRejections += o.forwardCheckRejections;
+    validMoveChecks += o.validMoveChecks;
+    instructorRejections += o.instructorRejections;
+    roomRejections += o.roomRejections;
+    sectionRejections += o.sectionRejections;
+    symmetrySkips += o.symmetrySkips;
+    satVariables += o.satVariables;
+    satClauses += o.satClauses;
+    satConflicts += o.satConflicts;
+    satDecisions += o.satDecisions;
+    satPropagations += o.satPropagations;
+    for (int b = 0; b < DOMAIN_SIZE_BUCKETS; b++) domainSizes[b] += o.domainSizes[b];
+    if (o.depthNodes.size() > depthNodes.size()) {
+        depthDomainSum.resize(o.depthNodes.size(), 0);
+        depthNodes.resize(o.depthNodes.size(), 0);
+    }
+    for (size_t d = 0; d < o.depthNodes.size(); d++) {
+        depthDomainSum[d] += o.depthDomainSum[d];
+        depthNodes[d] += o.depthNodes[d];
+    }
+}
+
+const int DEPTH_PROFILE_POINTS = 32; // Averages reported per response, each over a range of depths
+
+json countersToJson(const SolverCounters& counters) {
+    json out;
+    out["iterations"] = counters.iterations;
+    out["nodes"] = counters.nodes;
+    out["backtracks"] = counters.backtracks;
+    out["maxDepth"] = counters.maxDepth;
+    out["rejections"] = { {"nogood", counters.nogoodRejections}, {"forwardCheck", counters.forwardCheckRejections},
+        {"instructor", counters.instructorRejections}, {"room", counters.roomRejections}, {"section", counters.sectionRejections} };
+    out["validMoveChecks"] = counters.validMoveChecks;
+    out["symmetrySkips"] = counters.symmetrySkips;
+    if (counters.satClauses) {
+        out["sat"] = { {"variables", counters.satVariables}, {"clauses", counters.satClauses}, {"conflicts", counters.satConflicts},
+            {"decisions", counters.satDecisions}, {"propagations", counters.satPropagations} };
+    }
+
+    json histogram = json::array();
+    for (int b = 0; b < DOMAIN_SIZE_BUCKETS; b++) {
+        json bucket = { {"count", counters.domainSizes[b]} };
+        if (b + 1 < DOMAIN_SIZE_BUCKETS) bucket["maxSize"] = (1 << b) - 1;
+        histogram.push_back(bucket);
+    }
+    out["domainSizes"] = histogram;
+
+    json byDepth = json::array();
+    int depths = counters.depthNodes.size();
+    int step = max(1, (depths + DEPTH_PROFILE_POINTS - 1) / DEPTH_PROFILE_POINTS);
+    for (int from = 0; from < depths; from += step) {
+        long long sum = 0, nodes = 0;
+        for (int d = from; d < min(depths, from + step); d++) {
+            sum += counters.depthDomainSum[d];
+            nodes += counters.depthNodes[d];
+        }
+        if (nodes) byDepth.push_back({ {"depth", from}, {"nodes", nodes}, {"averageDomainSize", (double)sum / nodes} });
+    }
+    out["domainSizeByDepth"] = byDepth;
+    return out;
+}
+
+double elapsedMs(chrono::steady_clock::time_point since) {
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - since).count();
+}
+
+// --- Management Functions ---
+
+// Resets only the scheduling state, keeps inputs (Courses, Sections, etc.)
+template <class Mask>
+void resetSimulationState(SolverState<Mask>& st) {
+    const ProblemModel& model = *st.model;
+    st.staffBusy.resize(model.staffUnavailable.size());
+    for (size_t s = 0; s < model.staffUnavailable.size(); s++) st.staffBusy[s] = narrowMask<Mask>(model.staffUnavailable[s]);
+    st.roomBusy.assign(model.rooms.size(), 0);
+    st.sectionBusy.assign(model.sections.size(), 0);
+    st.staffLoad.assign(model.staffUnavailable.size(), 0);
+    st.roomLoad.assign(model.rooms.size(), 0);
+
+    size_t entries = model.sections.size() * model.grid.slots();
+    st.classStarts.assign(model.sections.size(), 0);
+    st.classCourse.assign(entries, -1);
+    st.classStaff.assign(entries, -1);
+    st.classRoom.assign(entries, -1);
+    st.classDuration.assign(entries, 0);
+
+    st.lastError = "";
+    st.iterationCount = 0;
+}
+
+string normalizeCourseType(const string& type) {
+    if (type == "lec" || type == "Lec" || type == "lecture") return "Lecture";
+    if (type == "tut" || type == "Tut" || type == "tutorial") return "Tutorial";
+    if (type == "lab" || type == "Lab") return "Lab";
+    return type;
+}
+
+string normalizeRoomType(const string& type) {
+    if (type == "lec" || type == "lecture") return "Lecture";
+    if (type == "tut" || type == "tutorial") return "Tutorial";
+    if (type == "lab" || type == "Lab") return "Lab";
+    return type;
+}
+
+void addCourse(ProblemModel& model, Course course) {
+    model.getCourse[course.courseID] = course;
+    model.courseIndex[course.courseID] = (int)model.courses.size();
+    model.courses.push_back(move(course));
+}
+
+Room roomFromJson(const json& r) {
+    Room room;
+    room.roomID = r.value("roomID", "");
+    room.type = normalizeRoomType(r.value("type", ""));
+    room.labType = r.value("labType", "");
+    room.capacity = r.value("capacity", 0);
+    return room;
+}
+
+void addRoom(ProblemModel& model, Room room) {
+    model.roomIndex.emplace(room.roomID, (int)model.rooms.size());
+    model.rooms.push_back(move(room));
+}
+
+void addSection(ProblemModel& model, Section section) {
+    int idx = model.sections.size();
+    model.sectionToIndex[section.sectionID] = idx;
+    model.groupToSectionIndices[section.groupID].push_back(idx);
+    model.yearToSectionIndices[section.year].push_back(idx); // Populate Year Map
+    model.sections.push_back(move(section));
+}
+
+// Intern staff IDs; an ID listed twice keeps its first entry, as the old lookups did
+void internStaff(ProblemModel& model) {
+    auto intern = [&](const string& id, const string& name, const vector<int>& unavailable, const vector<int>& preferred) {
+        if (model.staffIndex.count(id)) return;
+        model.staffIndex[id] = (int)model.staffIDs.size();
+        model.staffIDs.push_back(id);
+        model.staffNames.push_back(name);
+        model.staffUnavailable.push_back(toSlotMask(unavailable));
+        model.staffPreferred.push_back(toSlotMask(preferred));
+    };
+    for (auto& inst : model.instructors) intern(inst.instructorID, inst.name, inst.unavailableTimeSlots, inst.preferredTimeSlots);
+    for (auto& ta : model.tas) intern(ta.taID, ta.name, ta.unavailableTimeSlots, ta.preferredTimeSlots);
+}
+
+void parseGrid(WeekGrid& grid, const json& spec) {
+    auto count = [&](const char* key, int current) {
+        if (!spec.is_object()) return 0;
+        auto it = spec.find(key);
+        if (it == spec.end()) return current;
+        if (!it->is_number_integer()) return 0;
+        return (int)max((long long)INT_MIN, min(it->get<long long>(), (long long)INT_MAX));
+    };
+    grid.days = count("days", grid.days);
+    grid.periodsPerDay = count("periodsPerDay", grid.periodsPerDay);
+}
+
+void parseInputData(ProblemModel& model, const json& inputData) {
+    if (inputData.contains("grid")) parseGrid(model.grid, inputData.at("grid"));
+
+    if (inputData.contains("courses")) {
+        for (const json& c : inputData.at("courses")) {
+            Course course;
+            course.courseID = c.value("courseID", "");
+            course.courseName = c.value("courseName", "");
+            course.type = normalizeCourseType(c.value("type", ""));
+            course.labType = c.value("labType", "");
+            course.allYear = c.value("allYear", false);
+            course.duration = c.value("duration", 1);
+            addCourse(model, move(course));
+        }
+    }
+
+    if (inputData.contains("instructors")) {
+        for (const json& i : inputData.at("instructors")) {
+            Instructor instructor;
+            instructor.instructorID = i.value("instructorID", "");
+            instructor.name = i.value("name", "");
+            if (i.contains("qualifiedCourses")) i["qualifiedCourses"].get_to(instructor.qualifiedCourses);
+            if (i.contains("unavailableTimeSlots")) i["unavailableTimeSlots"].get_to(instructor.unavailableTimeSlots);
+            if (i.contains("preferredTimeSlots")) i["preferredTimeSlots"].get_to(instructor.preferredTimeSlots);
+            model.instructors.push_back(move(instructor));
+        }
+    }
+
+    if (inputData.contains("tas")) {
+        for (const json& t : inputData.at("tas")) {
+            TA ta;
+            ta.taID = t.value("taID", "");
+            ta.name = t.value("name", "");
+            if (t.contains("qualifiedCourses")) t["qualifiedCourses"].get_to(ta.qualifiedCourses);
+            if (t.contains("unavailableTimeSlots")) t["unavailableTimeSlots"].get_to(ta.unavailableTimeSlots);
+            if (t.contains("preferredTimeSlots")) t["preferredTimeSlots"].get_to(ta.preferredTimeSlots);
+            model.tas.push_back(move(ta));
+        }
+    }
+
+    if (inputData.contains("rooms")) {
+        for (const json& r : inputData.at("rooms")) addRoom(model, roomFromJson(r));
+    }
+
+    if (inputData.contains("sections")) {
+        for (const json& s : inputData.at("sections")) {
+            Section section;
+            section.sectionID = s.value("sectionID", "");
+            section.groupID = s.value("groupID", "");
+            section.year = s.value("year", 1);
+            section.studentCount = s.value("studentCount", 0);
+            if (s.contains("assignedCourses")) s["assignedCourses"].get_to(section.assignedCourses);
+            else if (s.contains("courses")) s["courses"].get_to(section.assignedCourses);
+            addSection(model, move(section));
+        }
+    }
+
+    internStaff(model);
+}
+
+// Parses, compiles and validates a request body and builds its sorted variable list.
+// Returns false with the 400 response body filled in when validation fails.
+bool buildProblem(const json& inputData, ProblemModel& model, vector<CSPVariable>& variables, json& errResponse, PhaseTimings* timings) {
+    auto parseStart = chrono::steady_clock::now();
+    parseInputData(model, inputData);
+    if (timings) timings->parse += elapsedMs(parseStart);
+    return compileProblem(model, variables, errResponse, timings);
+}
+
+// Rejects a model that fails validateInput(), filling the 400 response body
+bool rejectInvalid(const vector<string>& validationErrors, json& errResponse) {
+    if (validationErrors.empty()) return true;
+    errResponse["success"] = false;
+    errResponse["error"] = "Input validation failed";
+    errResponse["details"] = validationErrors;
+    cout << "Validation Failed: " << validationErrors.size() << " errors found." << endl;
+    return false;
+}
+
+// Rejects a problem that fails analyzeFeasibility(), filling the 400 response body
+bool rejectInfeasible(const vector<string>& problems, json& errResponse) {
+    if (problems.empty()) return true;
+    errResponse["success"] = false;
+    errResponse["error"] = "No valid timetable exists";
+    errResponse["details"] = problems;
+    cout << "Pre-solve analysis: " << problems.size() << " capacity problems found." << endl;
+    return false;
+}
+
+// Initial Heuristic Sort (Most Constrained First)
+// The solver orders variables dynamically; this order only breaks its final ties.
+// Sort priority: Hard Constraints > Longest Duration > Largest Student Count > Most Sections
+void sortVariables(vector<CSPVariable>& variables) {
+    sort(variables.begin(), variables.end(), [](const CSPVariable& a, const CSPVariable& b) {
+        if (a.isHardConstraint != b.isHardConstraint) return a.isHardConstraint > b.isHardConstraint;
+        if (a.duration != b.duration) return a.duration > b.duration;
+        if (a.totalStudents != b.totalStudents) return a.totalStudents > b.totalStudents;
+        return a.targetSectionIndices.size() > b.targetSectionIndices.size();
+        });
+}
+
+// Compiles and validates a parsed model and builds its sorted variable list
+bool compileProblem(ProblemModel& model, vector<CSPVariable>& variables, json& errResponse, PhaseTimings* timings) {
+    auto phaseStart = chrono::steady_clock::now();
+    auto endPhase = [&](double PhaseTimings::* phase) {
+        if (timings) timings->*phase += elapsedMs(phaseStart);
+        phaseStart = chrono::steady_clock::now();
+    };
+    compileModel(model);
+    endPhase(&PhaseTimings::parse);
+
+    // 1. Validate Input
+    bool valid = rejectInvalid(validateInput(model), errResponse);
+    endPhase(&PhaseTimings::validate);
+    if (!valid) return false;
+
+    // 2. Identify Variables
+    variables = identifyVariables(model);
+    compileVariables(model, variables);
+
+    // 3. Counting bounds that reject impossible inputs without searching
+    endPhase(&PhaseTimings::identify);
+    bool feasible = rejectInfeasible(analyzeFeasibility(model, variables), errResponse);
+    endPhase(&PhaseTimings::validate);
+    if (!feasible) return false;
+
+    // 4. Initial Heuristic Sort
+    sortVariables(variables);
+    endPhase(&PhaseTimings::identify);
+    return true;
+}
+
+// compileProblem() without its checks, for a base problem that scenario deltas may still repair.
+// Identification only reads the model, so an invalid one yields a partial list, never a crash.
+void compileUnchecked(ProblemModel& model, vector<CSPVariable>& variables) {
+    compileModel(model);
+    variables = identifyVariables(model);
+    compileVariables(model, variables);
+    sortVariables(variables);
+}
+
+// The checks of compileProblem() on an already compiled problem
+bool checkProblem(const ProblemModel& model, const vector<CSPVariable>& variables, json& errResponse, PhaseTimings* timings) {
+    auto phaseStart = chrono::steady_clock::now();
+    bool passed = rejectInvalid(validateInput(model), errResponse) && rejectInfeasible(analyzeFeasibility(model, variables), errResponse);
+    if (timings) timings->validate += elapsedMs(phaseStart);
+    return passed;
+}
+
+// --- Serialization ---
+
+void WireWriter::separator() {
+    if (afterKey) afterKey = false;
+    else if (!firstElement) out += ',';
+    firstElement = false;
+}
+
+void WireWriter::bigEndian(uint64_t value, int bytes) {
+    for (int i = bytes - 1; i >= 0; i--) out += (char)(value >> (8 * i));
+}
+
+void WireWriter::header(int major, uint64_t size) {
+    char type = (char)(major << 5);
+    if (size < 24) out += (char)(type | size);
+    else if (size <= 0xff) { out += (char)(type | 24); bigEndian(size, 1); }
+    else if (size <= 0xffff) { out += (char)(type | 25); bigEndian(size, 2); }
+    else if (size <= 0xffffffffULL) { out += (char)(type | 26); bigEndian(size, 4); }
+    else { out += (char)(type | 27); bigEndian(size, 8); }
+}
+
+void WireWriter::beginObject(size_t size) {
+    switch (format) {
+    case WireFormat::Json:
+        separator();
+        out += '{';
+        closers.push_back('}');
+        firstElement = true;
+        break;
+    case WireFormat::Cbor: header(5, size); break;
+    case WireFormat::MsgPack:
+        if (size < 16) out += (char)(0x80 | size);
+        else if (size <= 0xffff) { out += (char)0xde; bigEndian(size, 2); }
+        else { out += (char)0xdf; bigEndian(size, 4); }
+        break;
+    }
+}
+
+void WireWriter::beginArray(size_t size) {
+    switch (format) {
+    case WireFormat::Json:
+        separator();
+        out += '[';
+        closers.push_back(']');
+        firstElement = true;
+        break;
+    case WireFormat::Cbor: header(4, size); break;
+    case WireFormat::MsgPack:
+        if (size < 16) out += (char)(0x90 | size);
+        else if (size <= 0xffff) { out += (char)0xdc; bigEndian(size, 2); }
+        else { out += (char)0xdd; bigEndian(size, 4); }
+        break;
+    }
+}
+
+void WireWriter::end() {
+    if (format != WireFormat::Json) return;
+    out += closers.back();
+    closers.pop_back();
+    firstElement = false;
+}
+
+void WireWriter::key(const std::string& name) {
+    text(name);
+    if (format == WireFormat::Json) {
+        out += ':';
+        afterKey = true;
+    }
+}
+
+void WireWriter::text(const std::string& value) {
+    switch (format) {
+    case WireFormat::Json:
+        separator();
+        out += '"';
+        for (unsigned char c : value) {
+            if (c == '"' || c == '\\') {
+                out += '\\';
+                out += (char)c;
+            }
+            else if (c < 0x20) {
+                const char* hex = "0123456789abcdef";
+                out += "\\u00";
+                out += hex[c >> 4];
+                out += hex[c & 15];
+            }
+            else out += (char)c;
+        }
+        out += '"';
+        return;
+    case WireFormat::Cbor: header(3, value.size()); break;
+    case WireFormat::MsgPack:
+        if (value.size() < 32) out += (char)(0xa0 | value.size());
+        else if (value.size() <= 0xff) { out += (char)0xd9; bigEndian(value.size(), 1); }
+        else if (value.size() <= 0xffff) { out += (char)0xda; bigEndian(value.size(), 2); }
+        else { out += (char)0xdb; bigEndian(value.size(), 4); }
+        break;
+    }
+    out += value;
+}
+
+void WireWriter::integer(long long value) {
+    switch (format) {
+    case WireFormat::Json:
+        separator();
+        out += to_string(value);
+        break;
+    case WireFormat::Cbor:
+        if (value >= 0) header(0, (uint64_t)value);
+        else header(1, (uint64_t)(-(value + 1)));
+        break;
+    case WireFormat::MsgPack:
+        if (value >= -32 && value <= 127) out += (char)value; // Positive and negative fixint
+        else if (value >= 0 && value <= 0xff) { out += (char)0xcc; bigEndian(value, 1); }
+        else if (value >= 0 && value <= 0xffff) { out += (char)0xcd; bigEndian(value, 2); }
+        else if (value >= INT_MIN && value <= INT_MAX) { out += (char)0xd2; bigEndian((uint64_t)value, 4); }
+        else { out += (char)0xd3; bigEndian((uint64_t)value, 8); }
+        break;
+    }
+}
+
+void WireWriter::boolean(bool value) {
+    switch (format) {
+    case WireFormat::Json:
+        separator();
+        out += value ? "true" : "false";
+        break;
+    case WireFormat::Cbor: out += (char)(value ? 0xf5 : 0xf4); break;
+    case WireFormat::MsgPack: out += (char)(value ? 0xc3 : 0xc2); break;
+    }
+}
+
+void WireWriter::value(const json& value) {
+    switch (format) {
+    case WireFormat::Json:
+        separator();
+        out += value.dump();
+        break;
+    case WireFormat::Cbor: json::to_cbor(value, out); break;
+    case WireFormat::MsgPack: json::to_msgpack(value, out); break;
+    }
+}
+
+// Class entries are written straight from the section timetables, with names from the model's tables
+template <class Mask>
+void writeTimetable(WireWriter& writer, const SolverState<Mask>& st, const json& extra) {
+    const ProblemModel& model = *st.model;
+    const size_t ENTRY_FIELDS = 9;
+    int slots = model.grid.slots();
+
+    writer.beginObject(4 + extra.size());
+    writer.key("success");
+    writer.boolean(true);
+    writer.key("slotsMax");
+    writer.integer(slots);
+    writer.key("grid");
+    writer.beginObject(2);
+    writer.key("days");
+    writer.integer(model.grid.days);
+    writer.key("periodsPerDay");
+    writer.integer(model.grid.periodsPerDay);
+    writer.end();
+    writer.key("sections");
+    writer.beginArray(model.sections.size());
+    for (size_t j = 0; j < model.sections.size(); j++) {
+        const Section& sec = model.sections[j];
+        Mask starts = st.classStarts[j];
+
+        writer.beginObject(4);
+        writer.key("sectionID");
+        writer.text(sec.sectionID);
+        writer.key("groupID");
+        writer.text(sec.groupID);
+        writer.key("year");
+        writer.integer(sec.year);
+        writer.key("schedule");
+        writer.beginArray(popCount(starts));
+        for (; starts; starts &= starts - 1) {
+            int i = lowestBit(starts);
+            int entry = j * slots + i;
+            int staffIdx = st.classStaff[entry], roomIdx = st.classRoom[entry], duration = st.classDuration[entry];
+            const Course& course = model.courses[st.classCourse[entry]];
+            writer.beginObject(ENTRY_FIELDS);
+            writer.key("slotIndex");
+            writer.integer(i);
+            writer.key("courseID");
+            writer.text(course.courseID);
+            writer.key("courseName");
+            writer.text(course.courseName);
+            writer.key("type");
+            writer.text(course.type);
+            writer.key("roomID");
+            writer.text(roomIdx >= 0 ? model.rooms[roomIdx].roomID : "");
+            writer.key("instructorID");
+            writer.text(model.staffIDs[staffIdx]);
+            writer.key("instructorName");
+            writer.text(model.staffNames[staffIdx]);
+            writer.key("duration");
+            writer.integer(duration);
+            writer.key("slotRange");
+            writer.text(duration > 1 ? to_string(i) + "-" + to_string(i + duration - 1) : to_string(i));
+            writer.end();
+        }
+        writer.end();
+        writer.end();
+    }
+    writer.end();
+    for (auto& member : extra.items()) {
+        writer.key(member.key());
+        writer.value(member.value());
+    }
+    writer.end();
+}
+
+string encodeJson(const json& value, WireFormat format) {
+    WireWriter writer(format);
+    writer.value(value);
+    return move(writer.bytes());
+}
+
+// --- Streaming Input ---
+
+// SAX handler that reads a schedule request straight into a ProblemModel, without building a
+// DOM of the body. Top-level keys other than the five entity lists are request options, which
+// are small and collected into a json object. Unknown entity fields are skipped as before.
+// The first malformed value stops the parse with an error naming its JSON path.
+class ModelSaxHandler : public nlohmann::json_sax<json> {
+public:
+    ModelSaxHandler(ProblemModel& model, json& options) : model(model), options(options) {}
+
+    std::string error;
+
+    bool null() override { return scalar(json()); }
+    bool boolean(bool val) override { return scalar(json(val)); }
+    bool number_integer(number_integer_t val) override { return scalar(json(val)); }
+    bool number_unsigned(number_unsigned_t val) override { return scalar(json(val)); }
+    bool number_float(number_float_t val, const string_t&) override { return scalar(json(val)); }
+    bool string(string_t& val) override { return scalar(json(move(val))); }
+    bool binary(binary_t&) override { return scalar(json()); }
+
+    bool start_object(size_t) override { return start(false); }
+    bool start_array(size_t) override { return start(true); }
+    bool end_object() override { return end(); }
+    bool end_array() override { return end(); }
+
+    bool key(string_t& val) override {
+        frames.back().key = val;
+        if (capturing()) captureKeys.back() = move(val);
+        return true;
+    }
+
+    bool parse_error(size_t, const std::string&, const nlohmann::detail::exception& ex) override {
+        error = path() + ": " + ex.what();
+        return false;
+    }
+
+private:
+    enum class Entity { None, Courses, Instructors, TAs, Rooms, Sections };
+    enum class ListKind { None, Strings, Ints };
+
+    struct Frame {
+        bool isArray;
+        std::string key; // Current key of an object
+        int index = -1;  // Current element of an array
+    };
+
+    ProblemModel& model;
+    json& options;
+    vector<Frame> frames;
+    int skipDepth = 0; // Nesting inside an ignored field
+
+    // Option values being collected, innermost container last
+    vector<json*> captureStack;
+    vector<std::string> captureKeys;
+
+    // Entity under construction
+    Entity entity = Entity::None;
+    Course course;
+    Instructor instructor;
+    TA ta;
+    Room room;
+    Section section;
+    vector<std::string> sectionCourses; // The "courses" alias, used when "assignedCourses" is absent
+    bool hasAssignedCourses = false;
+
+    // List field under construction
+    ListKind listKind = ListKind::None;
+    vector<std::string>* stringList = nullptr;
+    vector<int>* intList = nullptr;
+
+    bool capturing() const { return !captureStack.empty(); }
+
+    std::string path() const {
+        std::string p = "$";
+        for (const Frame& f : frames) {
+            if (f.isArray) {
+                if (f.index >= 0) p += "[" + to_string(f.index) + "]";
+            }
+            else if (!f.key.empty()) p += "." + f.key;
+        }
+        return p;
+    }
+
+    bool fail(const std::string& message) {
+        error = path() + ": " + message;
+        return false;
+    }
+
+    // Advances the enclosing array to the element that is starting
+    void beginValue() {
+        if (!frames.empty() && frames.back().isArray) frames.back().index++;
+    }
+
+    // Stores an option value at the capture position, returning where it landed
+    json* capture(json value) {
+        if (captureStack.empty()) return &(options[frames[0].key] = move(value));
+        json& parent = *captureStack.back();
+        if (parent.is_array()) {
+            parent.push_back(move(value));
+            return &parent.back();
+        }
+        return &(parent[captureKeys.back()] = move(value));
+    }
+
+    static Entity entityFor(const std::string& key) {
+        if (key == "courses") return Entity::Courses;
+        if (key == "instructors") return Entity::Instructors;
+        if (key == "tas") return Entity::TAs;
+        if (key == "rooms") return Entity::Rooms;
+        if (key == "sections") return Entity::Sections;
+        return Entity::None;
+    }
+
+    bool scalar(json value) {
+        beginValue();
+        if (skipDepth) return true;
+        int depth = frames.size();
+        if (depth == 0) return fail("expected an object");
+        if (depth == 1) {
+            if (entityFor(frames[0].key) != Entity::None) {
+                if (value.is_null()) return true; // An empty list, as parseInputData() reads it
+                return fail("expected an array");
+            }
+            capture(move(value));
+            return true;
+        }
+        if (capturing()) {
+            capture(move(value));
+            return true;
+        }
+        if (depth == 2) return fail("expected an object");
+        if (depth == 3) return setField(frames[2].key, move(value));
+        return addListElement(value);
+    }
+
+    bool start(bool isArray) {
+        beginValue();
+        int depth = frames.size();
+        if (skipDepth || capturing()) {
+            if (skipDepth) skipDepth++;
+            else {
+                captureStack.push_back(capture(isArray ? json::array() : json::object()));
+                captureKeys.emplace_back();
+            }
+            frames.push_back({ isArray, {} });
+            return true;
+        }
+
+        if (depth == 0 && isArray) return fail("expected an object");
+        if (depth == 1) {
+            entity = entityFor(frames[0].key);
+            if (entity == Entity::None) {
+                captureStack.push_back(capture(isArray ? json::array() : json::object()));
+                captureKeys.emplace_back();
+            }
+            else if (!isArray) return fail("expected an array");
+        }
+        if (depth == 2) {
+            if (isArray) return fail("expected an object");
+            beginEntity();
+        }
+        if (depth == 3 && !beginField(frames[2].key, isArray)) return false;
+        if (depth == 4) return fail(listKind == ListKind::Ints ? "expected a number" : "expected a string");
+        frames.push_back({ isArray, {} });
+        return true;
+    }
+
+    bool end() {
+        frames.pop_back();
+        int depth = frames.size();
+        if (skipDepth) {
+            skipDepth--;
+            return true;
+        }
+        if (capturing()) {
+            captureStack.pop_back();
+            captureKeys.pop_back();
+            return true;
+        }
+        if (depth == 3) listKind = ListKind::None;
+        if (depth == 2) commitEntity();
+        if (depth == 1) entity = Entity::None;
+        return true;
+    }
+
+    void beginEntity() {
+        switch (entity) {
+        case Entity::Courses:
+            course = Course();
+            course.duration = 1;
+            course.allYear = false;
+            break;
+        case Entity::Instructors: instructor = Instructor(); break;
+        case Entity::TAs: ta = TA(); break;
+        case Entity::Rooms:
+            room = Room();
+            room.capacity = 0;
+            break;
+        case Entity::Sections:
+            section = Section();
+            section.year = 1;
+            section.studentCount = 0;
+            sectionCourses.clear();
+            hasAssignedCourses = false;
+            break;
+        case Entity::None: break;
+        }
+    }
+
+    void commitEntity() {
+        switch (entity) {
+        case Entity::Courses:
+            course.type = normalizeCourseType(course.type);
+            addCourse(model, move(course));
+            break;
+        case Entity::Instructors: model.instructors.push_back(move(instructor)); break;
+        case Entity::TAs: model.tas.push_back(move(ta)); break;
+        case Entity::Rooms:
+            room.type = normalizeRoomType(room.type);
+            addRoom(model, move(room));
+            break;
+        case Entity::Sections:
+            if (!hasAssignedCourses) section.assignedCourses = move(sectionCourses);
+            addSection(model, move(section));
+            break;
+        case Entity::None: break;
+        }
+    }
+
+    bool readString(json& value, std::string& out) {
+        if (!value.is_string()) return fail("expected a string");
+        out = move(value.get_ref<std::string&>());
+        return true;
+    }
+
+    bool readInt(const json& value, int& out) {
+        if (!value.is_number()) return fail("expected a number");
+        out = value.get<int>();
+        return true;
+    }
+
+    bool readBool(const json& value, bool& out) {
+        if (!value.is_boolean()) return fail("expected a boolean");
+        out = value.get<bool>();
+        return true;
+    }
+
+    bool setField(const std::string& field, json value) {
+        switch (entity) {
+        case Entity::Courses:
+            if (field == "courseID") return readString(value, course.courseID);
+            if (field == "courseName") return readString(value, course.courseName);
+            if (field == "type") return readString(value, course.type);
+            if (field == "labType") return readString(value, course.labType);
+            if (field == "allYear") return readBool(value, course.allYear);
+            if (field == "duration") return readInt(value, course.duration);
+            break;
+        case Entity::Instructors:
+            if (field == "instructorID") return readString(value, instructor.instructorID);
+            if (field == "name") return readString(value, instructor.name);
+            break;
+        case Entity::TAs:
+            if (field == "taID") return readString(value, ta.taID);
+            if (field == "name") return readString(value, ta.name);
+            break;
+        case Entity::Rooms:
+            if (field == "roomID") return readString(value, room.roomID);
+            if (field == "type") return readString(value, room.type);
+            if (field == "labType") return readString(value, room.labType);
+            if (field == "capacity") return readInt(value, room.capacity);
+            break;
+        case Entity::Sections:
+            if (field == "sectionID") return readString(value, section.sectionID);
+            if (field == "groupID") return readString(value, section.groupID);
+            if (field == "year") return readInt(value, section.year);
+            if (field == "studentCount") return readInt(value, section.studentCount);
+            break;
+        case Entity::None: break;
+        }
+        if (listField(field) != ListKind::None) return fail("expected an array");
+        return true; // Unknown field
+    }
+
+    // Which list the field is, pointing stringList/intList at its destination
+    ListKind listField(const std::string& field) {
+        vector<std::string>* qualified = nullptr;
+        vector<int>* unavailable = nullptr;
+        vector<int>* preferred = nullptr;
+        if (entity == Entity::Instructors) {
+            qualified = &instructor.qualifiedCourses;
+            unavailable = &instructor.unavailableTimeSlots;
+            preferred = &instructor.preferredTimeSlots;
+        }
+        else if (entity == Entity::TAs) {
+            qualified = &ta.qualifiedCourses;
+            unavailable = &ta.unavailableTimeSlots;
+            preferred = &ta.preferredTimeSlots;
+        }
+        else if (entity == Entity::Sections) {
+            if (field == "assignedCourses") stringList = &section.assignedCourses;
+            else if (field == "courses") stringList = &sectionCourses;
+            else return ListKind::None;
+            return ListKind::Strings;
+        }
+
+        if (!qualified) return ListKind::None;
+        if (field == "qualifiedCourses") stringList = qualified;
+        else if (field == "unavailableTimeSlots") intList = unavailable;
+        else if (field == "preferredTimeSlots") intList = preferred;
+        else return ListKind::None;
+        return field == "qualifiedCourses" ? ListKind::Strings : ListKind::Ints;
+    }
+
+    bool beginField(const std::string& field, bool isArray) {
+        ListKind kind = listField(field);
+        if (kind == ListKind::None) {
+            // A container where a scalar field belongs is malformed; anything else is ignored
+            if (!setField(field, isArray ? json::array() : json::object())) return false;
+            skipDepth = 1;
+            return true;
+        }
+        if (!isArray) return fail("expected an array");
+        listKind = kind;
+        if (kind == ListKind::Strings) stringList->clear();
+        else intList->clear();
+        if (entity == Entity::Sections && field == "assignedCourses") hasAssignedCourses = true;
+        return true;
+    }
+
+    bool addListElement(json& value) {
+        if (listKind == ListKind::Strings) {
+            if (!value.is_string()) return fail("expected a string");
+            stringList->push_back(move(value.get_ref<std::string&>()));
+        }
+        else {
+            if (!value.is_number()) return fail("expected a number");
+            intList->push_back(value.get<int>());
+        }
+        return true;
+    }
+};
+
+bool parseInputStream(const std::string& text, ProblemModel& model, json& options, std::string& error) {
+    options = json::object();
+    ModelSaxHandler handler(model, options);
+    if (!json::sax_parse(text, &handler)) {
+        error = handler.error;
+        return false;
+    }
+    // The seed is part of the cache key and reaches the solver as an unsigned
+    if (options.contains("seed") && !options["seed"].is_number_unsigned()) {
+        error = "$.seed: expected a non-negative integer";
+        return false;
+    }
+    if (options.contains("grid")) parseGrid(model.grid, options["grid"]);
+    internStaff(model);
+    return true;
+}
+
+// --- Warm Start ---
+
+const int RESOLVE_NEIGHBOURS = 4; // Kept classes freed next to each invalidated one, nearest in time first
+
+// Applies an input delta to a full request body:
+// { "staffUnavailable": [{ "id", "slots" }], "removeStaff": [ids], "addSections": [...],
+//   "removeSections": [ids], "addRooms": [...], "removeRooms": [ids] }
+void applyInputDelta(json& data, const json& delta) {
+    auto removeByID = [&](const char* list, const char* key, const json& ids) {
+        if (!data.contains(list)) return;
+        unordered_set<string> doomed;
+        for (auto& id : ids) doomed.insert(id.get<string>());
+        json kept = json::array();
+        for (auto& item : data[list]) if (!doomed.count(item.value(key, ""))) kept.push_back(item);
+        data[list] = kept;
+    };
+    auto append = [&](const char* list, const json& items) {
+        if (!data.contains(list)) data[list] = json::array();
+        for (auto& item : items) data[list].push_back(item);
+    };
+
+    if (delta.contains("staffUnavailable")) {
+        for (auto& change : delta["staffUnavailable"]) {
+            string id = change.value("id", "");
+            vector<int> slots = change.value("slots", vector<int>());
+            for (const char* list : { "instructors", "tas" }) {
+                if (!data.contains(list)) continue;
+                for (auto& staff : data[list]) {
+                    if (staff.value("instructorID", staff.value("taID", "")) != id) continue;
+                    if (!staff.contains("unavailableTimeSlots")) staff["unavailableTimeSlots"] = json::array();
+                    for (int s : slots) staff["unavailableTimeSlots"].push_back(s);
+                }
+            }
+        }
+    }
+    if (delta.contains("removeStaff")) {
+        removeByID("instructors", "instructorID", delta["removeStaff"]);
+        removeByID("tas", "taID", delta["removeStaff"]);
+    }
+    if (delta.contains("removeSections")) removeByID("sections", "sectionID", delta["removeSections"]);
+    if (delta.contains("addSections")) append("sections", delta["addSections"]);
+    if (delta.contains("removeRooms")) removeByID("rooms", "roomID", delta["removeRooms"]);
+    if (delta.contains("addRooms")) append("rooms", delta["addRooms"]);
+}
+
+bool checkInputDelta(const json& delta, string& error) {
+    if (!delta.is_object()) {
+        error = "delta: expected an object";
+        return false;
+    }
+    auto all = [](const json& items, bool (json::*is)() const) {
+        return all_of(items.begin(), items.end(), [&](const json& item) { return (item.*is)(); });
+    };
+    for (auto& change : delta.items()) {
+        const string& key = change.key();
+        const json& value = change.value();
+        bool valid;
+        if (key == "staffUnavailable") {
+            valid = value.is_array() && all_of(value.begin(), value.end(), [&](const json& item) {
+                return item.is_object() && item.contains("id") && item["id"].is_string()
+                    && item.contains("slots") && item["slots"].is_array() && all(item["slots"], &json::is_number_integer);
+            });
+            if (!valid) error = "delta.staffUnavailable: expected an array of { \"id\": string, \"slots\": [integers] }";
+        }
+        else if (key == "removeStaff" || key == "removeRooms" || key == "removeSections") {
+            valid = value.is_array() && all(value, &json::is_string);
+            if (!valid) error = "delta." + key + ": expected an array of IDs";
+        }
+        else if (key == "addRooms" || key == "addSections") {
+            valid = value.is_array() && all(value, &json::is_object);
+            if (!valid) error = "delta." + key + ": expected an array of objects";
+        }
+        else {
+            valid = false;
+            error = "delta." + key + ": unknown change";
+        }
+        if (!valid) return false;
+    }
+    return true;
+}
+
+bool isVariantDelta(const json& delta) {
+    return delta.is_object() && !delta.contains("addSections") && !delta.contains("removeSections");
+}
+
+ProblemVariant applyVariantDelta(const ProblemVariant& base, const json& delta) {
+    ProblemVariant variant = base;
+    bool candidatesChange = delta.contains("removeStaff") || delta.contains("addRooms") || delta.contains("removeRooms");
+    if (!candidatesChange && !delta.contains("staffUnavailable")) return variant; // Nothing to copy
+
+    auto model = make_shared<ProblemModel>(*base.model);
+    auto forStaff = [&](const string& id, const function<void(vector<string>&, vector<int>&)>& change) {
+        for (auto& inst : model->instructors) if (inst.instructorID == id) change(inst.qualifiedCourses, inst.unavailableTimeSlots);
+        for (auto& ta : model->tas) if (ta.taID == id) change(ta.qualifiedCourses, ta.unavailableTimeSlots);
+    };
+    if (delta.contains("staffUnavailable")) {
+        for (auto& change : delta["staffUnavailable"]) {
+            string id = change.value("id", "");
+            vector<int> slots = change.value("slots", vector<int>());
+            forStaff(id, [&](vector<string>&, vector<int>& unavailable) { unavailable.insert(unavailable.end(), slots.begin(), slots.end()); });
+            auto it = model->staffIndex.find(id);
+            if (it != model->staffIndex.end()) model->staffUnavailable[it->second] |= toSlotMask(slots);
+        }
+    }
+    // Removed staff keep their index but teach nothing
+    if (delta.contains("removeStaff")) {
+        for (auto& id : delta["removeStaff"]) forStaff(id.get<string>(), [](vector<string>& qualified, vector<int>&) { qualified.clear(); });
+    }
+    if (delta.contains("addRooms")) {
+        for (auto& r : delta["addRooms"]) addRoom(*model, roomFromJson(r));
+    }
+    compileModel(*model);
+    // Removed rooms keep their index but leave the eligibility buckets
+    if (delta.contains("removeRooms")) {
+        unordered_set<string> doomed;
+        for (auto& id : delta["removeRooms"]) doomed.insert(id.get<string>());
+        for (auto& kind : model->roomsByKind) {
+            vector<int>& rooms = kind.second;
+            rooms.erase(remove_if(rooms.begin(), rooms.end(), [&](int r) { return doomed.count(model->rooms[r].roomID) > 0; }), rooms.end());
+        }
+    }
+    variant.model = model;
+
+    if (candidatesChange) {
+        auto variables = make_shared<vector<CSPVariable>>(*base.variables);
+        compileVariables(*model, *variables);
+        variant.variables = variables;
+    }
+    return variant;
+}
+
+// Maps a previous /api/schedule response onto the variables. A variable gets its old value if its
+// sections that had the class all agree on slot, staff and room (a newly added section simply
+// has no entry yet); otherwise startSlot stays -1.
+vector<CSPValue> previousAssignment(const ProblemModel& model, const vector<CSPVariable>& variables, const json& previous) {
+    map<pair<int, string>, json> entries; // (section, courseID) -> schedule entry
+    if (previous.contains("sections")) {
+        for (auto& sec : previous["sections"]) {
+            auto it = model.sectionToIndex.find(sec.value("sectionID", ""));
+            if (it == model.sectionToIndex.end() || !sec.contains("schedule")) continue;
+            for (auto& entry : sec["schedule"]) entries[{ it->second, entry.value("courseID", "") }] = entry;
+        }
+    }
+
+    vector<CSPValue> values(variables.size(), CSPValue{ -1, -1, -1 });
+    for (size_t v = 0; v < variables.size(); v++) {
+        const CSPVariable& var = variables[v];
+        const json* first = nullptr;
+        bool consistent = true;
+        for (int secIdx : var.targetSectionIndices) {
+            auto it = entries.find({ secIdx, var.courseID });
+            if (it == entries.end()) continue;
+            if (!first) first = &it->second;
+            else if (it->second.value("slotIndex", -1) != first->value("slotIndex", -1) ||
+                it->second.value("instructorID", "") != first->value("instructorID", "") ||
+                it->second.value("roomID", "") != first->value("roomID", "")) { consistent = false; break; }
+        }
+        if (!consistent || !first) continue;
+
+        int start = first->value("slotIndex", -1);
+        auto staffIt = model.staffIndex.find(first->value("instructorID", ""));
+        string roomID = first->value("roomID", "");
+        auto roomIt = model.roomIndex.find(roomID);
+        int roomIdx = roomID.empty() ? -1 : (roomIt == model.roomIndex.end() ? -2 : roomIt->second);
+        if (!model.grid.fits(start, var.duration) || staffIt == model.staffIndex.end()) continue;
+        if (find(var.candidateStaff.begin(), var.candidateStaff.end(), staffIt->second) == var.candidateStaff.end()) continue;
+        if (find(var.candidateRooms.begin(), var.candidateRooms.end(), roomIdx) == var.candidateRooms.end()) continue;
+        values[v] = { start, staffIt->second, roomIdx };
+    }
+    return values;
+}
+
+// Warm-started re-solve: keeps every previous value that is still valid, frees the invalid ones
+// plus a few classes next to each, and lets the exact solver place those, trying old values first.
+// If that neighbourhood cannot be completed it widens to everything sharing a section, staff
+// member or room with an invalid class, and finally to a full solve that still prefers old values.
+template <class Mask>
+bool resolveFromPrevious(SolverState<Mask>& st, const vector<CSPVariable>& variables, const vector<CSPValue>& previous, int& freedCount, int& rounds) {
+    int n = variables.size();
+
+    // Which previous values still fit on a board of the other kept values
+    resetSimulationState(st);
+    vector<char> invalid(n, 0);
+    for (int v = 0; v < n; v++) {
+        if (previous[v].startSlot >= 0 && isValidMove(st, variables[v], previous[v])) applyMove(st, variables[v], previous[v]);
+        else invalid[v] = 1;
+    }
+
+    auto sharesResource = [&](int u, int w) {
+        if (previous[w].startSlot < 0) return false;
+        if (previous[u].startSlot >= 0) {
+            if (previous[u].staffIdx == previous[w].staffIdx) return true;
+            if (previous[u].roomIdx >= 0 && previous[u].roomIdx == previous[w].roomIdx) return true;
+        }
+        for (int a : variables[u].targetSectionIndices)
+            for (int b : variables[w].targetSectionIndices) if (a == b) return true;
+        return false;
+    };
+
+    for (rounds = 1; rounds <= 3; rounds++) {
+        vector<char> fixed(n, rounds < 3);
+        for (int u = 0; u < n && rounds < 3; u++) {
+            if (!invalid[u]) continue;
+            fixed[u] = 0;
+
+            // Kept neighbours, nearest in time to u's old (or, for new classes, any) start
+            vector<pair<int, int>> near; // (distance, variable)
+            for (int w = 0; w < n; w++) {
+                if (invalid[w] || !sharesResource(u, w)) continue;
+                int distance = previous[u].startSlot >= 0 ? abs(previous[w].startSlot - previous[u].startSlot) : 0;
+                near.push_back({ distance, w });
+            }
+            sort(near.begin(), near.end());
+            size_t limit = rounds == 1 ? min(near.size(), (size_t)RESOLVE_NEIGHBOURS) : near.size();
+            for (size_t k = 0; k < limit; k++) fixed[near[k].second] = 0;
+        }
+
+        freedCount = count(fixed.begin(), fixed.end(), 0);
+        int budget = rounds == 3 ? 4 * HANDOFF_ITERATIONS : HANDOFF_ITERATIONS;
+        if (completeAssignment(st, variables, previous, fixed, budget)) return true;
+        if (chrono::duration_cast<chrono::seconds>(chrono::steady_clock::now() - st.startTime).count() > ATTEMPT_TIME_LIMIT_S) break;
+        if (st.control.abortFlag && st.control.abortFlag->load()) break;
+    }
+    rounds = min(rounds, 3);
+    return false;
+}
+
+// --- Mask Widths ---
+
+// The solver entry points for each mask width withSlotMask() dispatches to
+#define INSTANTIATE_SOLVER(Mask) \
+    template void resetSimulationState(SolverState<Mask>&); \
+    template bool isInstructorAvailable(const SolverState<Mask>&, int, int, int); \
+    template bool isRoomAvailable(const SolverState<Mask>&, int, int, int); \
+    template bool isValidMove(const SolverState<Mask>&, const CSPVariable&, const CSPValue&); \
+    template void applyMove(SolverState<Mask>&, const CSPVariable&, const CSPValue&); \
+    template void undoMove(SolverState<Mask>&, const CSPVariable&, const CSPValue&); \
+    template Mask computeLiveStarts(const SolverState<Mask>&, const CSPVariable&); \
+    template void openDomain(const SolverState<Mask>&, const CSPVariable&, Mask, DomainCursor<Mask>&); \
+    template bool nextValue(const SolverState<Mask>&, const CSPVariable&, DomainCursor<Mask>&, CSPValue&); \
+    template long long moveDelta(const SolverState<Mask>&, const CSPVariable&, const CSPValue&); \
+    template ObjectiveTerms evaluateObjective(const SolverState<Mask>&, const vector<CSPVariable>&); \
+    template void writeTimetable(WireWriter&, const SolverState<Mask>&, const json&); \
+    template bool solveIterative(SolverState<Mask>&, const vector<CSPVariable>&); \
+    template bool completeAssignment(SolverState<Mask>&, const vector<CSPVariable>&, const vector<CSPValue>&, const vector<char>&, int); \
+    template bool solveLocalSearch(SolverState<Mask>&, const vector<CSPVariable>&, unsigned); \
+    template SatEncoding encodeSat(const SolverState<Mask>&, const vector<CSPVariable>&); \
+    template bool solveSat(SolverState<Mask>&, const vector<CSPVariable>&, unsigned); \
+    template int improveTimetable(SolverState<Mask>&, const vector<CSPVariable>&, chrono::steady_clock::time_point, unsigned); \
+    template bool runStrategy(SolverState<Mask>&, const ProblemModel&, const vector<CSPVariable>&, const SolverStrategy&, const atomic<bool>*, const SolveControl&); \
+    template SolveOutcome<Mask> solveWithRetries<Mask>(const ProblemModel&, const vector<CSPVariable>&, VariableOrdering, SolverEngine, const SolveControl&); \
+    template SolveOutcome<Mask> solvePortfolio<Mask>(WorkerPool&, const ProblemModel&, const vector<CSPVariable>&, VariableOrdering, SolverEngine, int, const SolveControl&); \
+    template SolveOutcome<Mask> solveDecomposed<Mask>(WorkerPool&, const ProblemModel&, const vector<CSPVariable>&, VariableOrdering, SolverEngine, int, const SolveControl&); \
+    template bool resolveFromPrevious(SolverState<Mask>&, const vector<CSPVariable>&, const vector<CSPValue>&, int&, int&);
+
+INSTANTIATE_SOLVER(uint64_t)
+INSTANTIATE_SOLVER(WideMask<2>)
+INSTANTIATE_SOLVER(WideMask<4>)
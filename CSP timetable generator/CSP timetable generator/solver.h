@@ -0,0 +1,734 @@
+﻿#pragma once
+
+// Solver core of the timetable generator: problem model, CSP search, local search, optimization
+// and warm starts. Free of any HTTP code so the server and the benchmarks link the same solver.
+
+#include <nlohmann/json.hpp>
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <map>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <cstdint>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <queue>
+#include <functional>
+#include <memory>
+#include "sat.h"
+#include "trace.h"
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+using json = nlohmann::json;
+
+// --- Bit Helpers ---
+
+// Population count and lowest/highest set bit of a 64-bit word (x must be non-zero for the scans)
+#if defined(_MSC_VER) && defined(_M_X64)
+inline int popCount(uint64_t x) { return (int)__popcnt64(x); }
+inline int lowestBit(uint64_t x) { unsigned long i; _BitScanForward64(&i, x); return (int)i; }
+inline int highestBit(uint64_t x) { unsigned long i; _BitScanReverse64(&i, x); return (int)i; }
+#elif defined(_MSC_VER)
+// 32-bit targets have no 64-bit forms of the intrinsics: combine the two halves
+inline int popCount(uint64_t x) { return (int)(__popcnt((unsigned)x) + __popcnt((unsigned)(x >> 32))); }
+inline int lowestBit(uint64_t x) {
+    unsigned long i;
+    if (_BitScanForward(&i, (unsigned long)x)) return (int)i;
+    _BitScanForward(&i, (unsigned long)(x >> 32));
+    return (int)i + 32;
+}
+inline int highestBit(uint64_t x) {
+    unsigned long i;
+    if (_BitScanReverse(&i, (unsigned long)(x >> 32))) return (int)i + 32;
+    _BitScanReverse(&i, (unsigned long)x);
+    return (int)i;
+}
+#else
+inline int popCount(uint64_t x) { return __builtin_popcountll(x); }
+inline int lowestBit(uint64_t x) { return __builtin_ctzll(x); }
+inline int highestBit(uint64_t x) { return 63 - __builtin_clzll(x); }
+#endif
+
+// Fixed-width bit set of several 64-bit words, for weeks of more than 64 slots. It has the
+// operators the solver applies to uint64_t masks, so the search is written once for every width.
+template <int Words>
+struct WideMask {
+    uint64_t w[Words];
+
+    WideMask(uint64_t low = 0) {
+        w[0] = low;
+        for (int i = 1; i < Words; i++) w[i] = 0;
+    }
+
+    explicit operator bool() const {
+        for (int i = 0; i < Words; i++) if (w[i]) return true;
+        return false;
+    }
+
+    WideMask operator~() const { WideMask r; for (int i = 0; i < Words; i++) r.w[i] = ~w[i]; return r; }
+    WideMask& operator|=(const WideMask& o) { for (int i = 0; i < Words; i++) w[i] |= o.w[i]; return *this; }
+    WideMask& operator&=(const WideMask& o) { for (int i = 0; i < Words; i++) w[i] &= o.w[i]; return *this; }
+    friend WideMask operator|(WideMask a, const WideMask& b) { return a |= b; }
+    friend WideMask operator&(WideMask a, const WideMask& b) { return a &= b; }
+    friend bool operator==(const WideMask& a, const WideMask& b) {
+        for (int i = 0; i < Words; i++) if (a.w[i] != b.w[i]) return false;
+        return true;
+    }
+    friend bool operator!=(const WideMask& a, const WideMask& b) { return !(a == b); }
+
+    WideMask operator<<(int k) const {
+        WideMask r;
+        int words = k >> 6, bits = k & 63;
+        for (int i = Words - 1; i >= words; i--) {
+            r.w[i] = w[i - words] << bits;
+            if (bits && i > words) r.w[i] |= w[i - words - 1] >> (64 - bits);
+        }
+        return r;
+    }
+
+    WideMask operator>>(int k) const {
+        WideMask r;
+        int words = k >> 6, bits = k & 63;
+        for (int i = 0; i + words < Words; i++) {
+            r.w[i] = w[i + words] >> bits;
+            if (bits && i + words + 1 < Words) r.w[i] |= w[i + words + 1] << (64 - bits);
+        }
+        return r;
+    }
+
+    // Subtraction with borrow, for the m &= m - 1 idiom that clears the lowest set bit
+    WideMask operator-(uint64_t k) const {
+        WideMask r = *this;
+        for (int i = 0; i < Words && k; i++) {
+            uint64_t before = r.w[i];
+            r.w[i] -= k;
+            k = before < k;
+        }
+        return r;
+    }
+
+    friend int popCount(const WideMask& m) {
+        int c = 0;
+        for (int i = 0; i < Words; i++) c += popCount(m.w[i]);
+        return c;
+    }
+    friend int lowestBit(const WideMask& m) {
+        int i = 0;
+        while (!m.w[i]) i++;
+        return i * 64 + lowestBit(m.w[i]);
+    }
+    friend int highestBit(const WideMask& m) {
+        int i = Words - 1;
+        while (!m.w[i]) i--;
+        return i * 64 + highestBit(m.w[i]);
+    }
+};
+
+// Bits [0, n) of a mask of the second argument's type
+inline uint64_t lowBits(int n, uint64_t) {
+    return n >= 64 ? ~uint64_t(0) : (uint64_t(1) << n) - 1;
+}
+
+template <int Words>
+inline WideMask<Words> lowBits(int n, const WideMask<Words>&) {
+    WideMask<Words> r;
+    for (int i = 0; i < Words; i++) r.w[i] = n <= 64 * i ? 0 : lowBits(n - 64 * i, uint64_t());
+    return r;
+}
+
+// --- Data Structures ---
+
+struct Course {
+    std::string courseID, courseName, type;
+    std::string labType;
+    int duration;
+    bool allYear;
+};
+
+struct Instructor {
+    std::string instructorID, name;
+    std::vector<std::string> qualifiedCourses;
+    std::vector<int> preferredTimeSlots;
+    std::vector<int> unavailableTimeSlots;
+};
+
+struct TA {
+    std::string taID, name;
+    std::vector<std::string> qualifiedCourses;
+    std::vector<int> preferredTimeSlots;
+    std::vector<int> unavailableTimeSlots;
+};
+
+struct Room {
+    std::string roomID, type;
+    std::string labType;
+    int capacity;
+};
+
+struct Section {
+    std::string sectionID, groupID;
+    int year, studentCount;
+    std::vector<std::string> assignedCourses;
+};
+
+struct CSPVariable {
+    int id;
+    std::string courseID;
+    int courseIdx; // The course's entry in model.courses
+    std::vector<int> targetSectionIndices; // Indices in the global 'sections' vector
+    int totalStudents;
+
+    int duration;
+    bool isHardConstraint; // e.g., Fixed schedules
+
+    // Filled by compileVariables(); immutable during search
+    std::vector<int> candidateStaff; // Qualified staff indices
+    std::vector<int> candidateRooms; // Eligible room indices ({-1} when no room is needed)
+};
+
+struct CSPValue {
+    int startSlot;
+    int staffIdx; // Interned instructor/TA index
+    int roomIdx;  // Interned room index, -1 when the course needs no room
+
+    bool operator==(const CSPValue& o) const { return startSlot == o.startSlot && staffIdx == o.staffIdx && roomIdx == o.roomIdx; }
+};
+
+// Set of search depths, one bit each (conflict sets for backjumping)
+struct DepthSet {
+    std::vector<uint64_t> words;
+
+    DepthSet(int n = 0) : words((n + 63) / 64, 0) {}
+    void set(int d) { words[d >> 6] |= uint64_t(1) << (d & 63); }
+    void reset(int d) { words[d >> 6] &= ~(uint64_t(1) << (d & 63)); }
+    void clear() { std::fill(words.begin(), words.end(), 0); }
+    void unionWith(const DepthSet& o) { for (size_t i = 0; i < words.size(); i++) words[i] |= o.words[i]; }
+    int count() const { int c = 0; for (uint64_t w : words) c += popCount(w); return c; }
+    int highest() const {
+        for (int i = (int)words.size() - 1; i >= 0; i--) {
+            if (words[i]) return i * 64 + highestBit(words[i]);
+        }
+        return -1;
+    }
+    template <typename F> void forEach(F f) const {
+        for (size_t i = 0; i < words.size(); i++) {
+            for (uint64_t w = words[i]; w; w &= w - 1) f((int)(i * 64 + lowestBit(w)));
+        }
+    }
+};
+
+// --- Problem Model ---
+
+const int MAX_SLOTS = 256; // Largest week a request may ask for, in slots
+
+// Slot set of the model at the widest supported week; the solver narrows it to its own mask width
+typedef WideMask<MAX_SLOTS / 64> GridMask;
+
+// Week layout of a request: `days` days of `periodsPerDay` periods, slot = day * periodsPerDay + period.
+// A class never runs from one day into the next.
+struct WeekGrid {
+    int days = 5;
+    int periodsPerDay = 8;
+
+    int slots() const { return days * periodsPerDay; }
+    bool valid() const { return days >= 1 && periodsPerDay >= 1 && days <= MAX_SLOTS && periodsPerDay <= MAX_SLOTS && slots() <= MAX_SLOTS; }
+    // Whether a duration-long class starting at startSlot lies within one day of the week
+    bool fits(int startSlot, int duration) const {
+        return startSlot >= 0 && duration >= 1 && startSlot + duration <= slots() && startSlot % periodsPerDay + duration <= periodsPerDay;
+    }
+};
+
+// Soft-constraint weights; all zero unless the request asks for optimization
+struct ObjectiveWeights {
+    long long preference = 0; // Per class slot outside the staff member's preferred slots
+    long long gaps = 0;       // Per idle period between a section's or staff member's classes in a day
+    long long dailyLoad = 0;  // Per squared class count of a section or staff member in a day
+};
+
+struct ObjectiveTerms {
+    long long preference = 0, gaps = 0, dailyLoad = 0;
+};
+
+// Everything parsed from one request plus the tables compiled from it. Each request builds
+// its own model, and it is read-only once solving starts, so requests never share state.
+struct ProblemModel {
+    std::vector<Course> courses;
+    std::vector<Instructor> instructors;
+    std::vector<TA> tas;
+    std::vector<Room> rooms;
+    std::vector<Section> sections;
+
+    // Index maps
+    std::unordered_map<std::string, int> sectionToIndex;
+    std::unordered_map<std::string, std::vector<int>> groupToSectionIndices;
+    std::unordered_map<int, std::vector<int>> yearToSectionIndices; // New: Map Year -> List of Section Indices
+    std::unordered_map<std::string, Course> getCourse;
+    std::unordered_map<std::string, int> courseIndex; // courseID -> index in courses of the getCourse entry
+
+    // Interned resource IDs: instructors and TAs share one dense "staff" index space
+    std::vector<std::string> staffIDs;
+    std::vector<std::string> staffNames;
+    std::vector<GridMask> staffUnavailable;
+    std::vector<GridMask> staffPreferred; // 0 when the staff member states no preference
+    std::unordered_map<std::string, int> staffIndex;
+    std::unordered_map<std::string, int> roomIndex;
+
+    // Compiled model (built once by compileModel() after parsing)
+    std::unordered_map<std::string, std::vector<int>> courseQualifiedStaff; // courseID -> staff indices
+    std::map<std::pair<std::string, std::string>, std::vector<int>> roomsByKind;       // (type, labType) -> room indices
+    // Interchangeable resources, named by their lowest member: rooms of one type, lab type and
+    // capacity; staff with the same qualifications, unavailability and preferences
+    std::vector<int> roomClass, staffClass;
+    std::vector<GridMask> startsWithinDay; // [duration] -> starts whose class ends on the day it begins
+
+    WeekGrid grid;
+    ObjectiveWeights weights;
+};
+
+const int MAX_ITERATIONS = 2000000; // Reduced slightly to allow for retries
+const int MAX_RETRIES = 5;          // Number of times to reseed tie-breaks and retry
+const int ATTEMPT_TIME_LIMIT_S = 30;
+const int ROOM_SPLIT_ITERATIONS = MAX_ITERATIONS / 10; // Per cluster, before falling back to a joint solve
+const int ROOM_SPLIT_TIME_LIMIT_MS = ATTEMPT_TIME_LIMIT_S * 1000 / 10; // All clusters together, likewise
+const int AUTO_STALL_ITERATIONS = MAX_ITERATIONS / 20; // Backtracking budget of the auto engine before the SAT handoff
+
+// --- Helper Functions ---
+
+// Bits [startSlot, startSlot + duration)
+template <class Mask>
+inline Mask slotWindow(int startSlot, int duration) {
+    return lowBits(duration, Mask()) << startSlot;
+}
+
+// The low bits of a model mask, as a solver mask (grids that use it have no slots above its width)
+inline void narrowInto(uint64_t& out, const GridMask& mask) { out = mask.w[0]; }
+
+template <int Words>
+inline void narrowInto(WideMask<Words>& out, const GridMask& mask) {
+    for (int i = 0; i < Words; i++) out.w[i] = mask.w[i];
+}
+
+template <class Mask>
+inline Mask narrowMask(const GridMask& mask) {
+    Mask out;
+    narrowInto(out, mask);
+    return out;
+}
+
+// Start slots whose duration-long window avoids every busy bit, among the starts that fit a day
+template <class Mask>
+inline Mask freeStarts(Mask busy, int duration, Mask fits) {
+    Mask blocked = busy;
+    for (int k = 1; k < duration; k++) blocked |= busy >> k;
+    return ~blocked & fits;
+}
+
+// Starts of a duration-long window that would overlap any bit of the given window
+template <class Mask>
+inline Mask overlappingStarts(Mask window, int duration) {
+    Mask starts = window;
+    for (int k = 1; k < duration; k++) starts |= window >> k;
+    return starts;
+}
+
+GridMask toSlotMask(const std::vector<int>& slots);
+bool needsNoRoom(const std::string& courseID);
+
+// --- Solver State ---
+
+// Static: the pre-sorted order. MRV: fewest live starts, ties by degree.
+// DomWdeg: live starts divided by failure weight, so variables that keep failing go first.
+enum class VariableOrdering { Static, MRV, DomWdeg };
+
+// Backtrack: the complete FC-CBJ search. LocalSearch: min-conflicts repair for large instances,
+// which finds timetables faster but can never prove that none exists. Sat: the problem encoded as
+// CNF for the embedded CDCL solver, also complete and strongest on tightly constrained requests.
+// Auto: backtracking, handing off to the SAT backend when it stalls.
+enum class SolverEngine { Backtrack, LocalSearch, Sat, Auto };
+
+// A nogood is a set of assignments that cannot all hold in any solution
+struct Nogood {
+    std::vector<std::pair<int, CSPValue>> literals; // (variable, value)
+};
+const size_t MAX_NOGOODS = 20000;
+const int MAX_NOGOOD_SIZE = 8;
+
+// Live counters of a running solve, written by the search and read by job status requests
+struct SolveProgress {
+    std::atomic<long long> iterations{ 0 }; // Summed over all attempts and portfolio members
+    std::atomic<int> depth{ 0 };            // Variables assigned by the most recent report
+    std::atomic<int> bestDepth{ 0 };        // Largest partial assignment reached so far
+    std::atomic<int> attempts{ 0 };
+    std::atomic<int> variables{ 0 };
+};
+const int PROGRESS_INTERVAL = 256; // Iterations between progress reports
+
+// Caller-side hooks into a solve: an abort flag (job cancellation), where to report progress,
+// the seed for every randomized choice (0 draws a fresh one per solve), and an optional trace
+// file that every solveIterative() run of the request appends to
+struct SolveControl {
+    const std::atomic<bool>* abortFlag = nullptr;
+    SolveProgress* progress = nullptr;
+    unsigned seed = 0;
+    SearchTrace* trace = nullptr;
+    uint32_t traceRequest = 0; // Request number in the trace, from SearchTrace::beginRequest()
+    std::chrono::milliseconds timeSpent{ 0 }; // Already used by this solve, taken off the first attempt's time limit
+};
+
+inline unsigned solveSeed(const SolveControl& control) {
+    return control.seed ? control.seed : std::random_device()();
+}
+
+// Search statistics of one solver instance. Plain fields: a state is only used by the thread
+// running it, so counting is a bare increment, and totals are only summed once solves finish.
+const int DOMAIN_SIZE_BUCKETS = 12; // Bucket b > 0 holds domain sizes in [2^(b-1), 2^b), the last one everything above
+struct SolverCounters {
+    long long iterations = 0;
+    long long nodes = 0;      // Variables assigned by the search (moves, for local search)
+    long long backtracks = 0; // Dead ends, each resolved by one backjump
+    int maxDepth = 0;         // Most variables assigned at once
+    long long nogoodRejections = 0, forwardCheckRejections = 0; // Values the search tried and dropped
+    long long validMoveChecks = 0;
+    long long instructorRejections = 0, roomRejections = 0, sectionRejections = 0; // isValidMove, by first failed check
+    long long symmetrySkips = 0; // Candidate staff/rooms left out of a domain as copies of an unused one
+    long long satVariables = 0, satClauses = 0; // Size of the SAT encodings built
+    long long satConflicts = 0, satDecisions = 0, satPropagations = 0;
+    long long domainSizes[DOMAIN_SIZE_BUCKETS] = {}; // Values each node got to try
+    std::vector<long long> depthDomainSum, depthNodes; // Per search depth, for average domain size by depth
+
+    void recordDomain(int depth, size_t size) {
+        domainSizes[size ? std::min(DOMAIN_SIZE_BUCKETS - 1, highestBit(size) + 1) : 0]++;
+        if (depth >= (int)depthNodes.size()) {
+            depthDomainSum.resize(depth + 1, 0);
+            depthNodes.resize(depth + 1, 0);
+        }
+        depthDomainSum[depth] += size;
+        depthNodes[depth]++;
+    }
+
+    void merge(const SolverCounters& o);
+};
+
+// All mutable search state of one solver instance. Instances only share their request's
+// ProblemModel, which is read-only while solving, so any number of them can search concurrently.
+// Mask is the slot set type: uint64_t for weeks of up to 64 slots, WideMask<2> or <4> beyond.
+template <class Mask>
+struct SolverState {
+    const ProblemModel* model = nullptr;
+
+    // Constraint Sets (per resource: busy | unavailable)
+    std::vector<Mask> staffBusy;
+    std::vector<Mask> roomBusy;
+    std::vector<Mask> sectionBusy;
+    std::vector<int> staffLoad, roomLoad; // Classes booked; 0 marks a resource nothing uses yet
+
+    // Section timetables as a structure of arrays. sectionBusy above is each section's occupancy,
+    // classStarts marks where its classes begin, and the class starting at slot t of section s is
+    // described at [s * grid slots + t]. Undoing a move only clears bits; entries are overwritten.
+    std::vector<Mask> classStarts;
+    std::vector<int> classCourse; // Index in model.courses
+    std::vector<int> classStaff;
+    std::vector<int> classRoom;   // -1 when the class needs no room
+    std::vector<uint8_t> classDuration;
+
+    // Forward checking state, indexed by position in the solver's variable list.
+    // A variable's live domain is factored as {(start, staff, room)}: liveStarts holds every start
+    // where its sections, at least one candidate staff and at least one candidate room are free,
+    // which is exactly the set of starts that still have a valid value.
+    std::vector<Mask> liveStarts;
+    std::vector<char> isAssigned;
+    std::vector<std::pair<int, Mask>> domainTrail; // (variable, previous liveStarts), undone LIFO
+    std::vector<std::vector<int>> sectionWatchers, staffWatchers, roomWatchers;
+    std::vector<int> seenStamp;
+    int stamp = 0;
+
+    // Conflict-directed backjumping state (FC-CBJ).
+    // pruneSets[v]: depths whose moves removed values from v's domain (undone with the trail).
+    // conflictSets[v]: depths to blame for the values v has tried so far.
+    std::vector<DepthSet> pruneSets, conflictSets;
+    std::vector<int> pruneTrail; // Variables that got the current depth added to their pruneSet
+    std::vector<int> varDepth;   // Depth a variable is assigned at, -1 while unassigned
+    std::vector<CSPValue> assignedValue;
+    std::vector<CSPValue> preferredValue; // Tried first when still in the domain (warm starts); empty if none
+    bool provedInfeasible = false;
+
+    // Nogood store, learnt at backjumps and valid for every retry of the same request.
+    // Bounded, oldest evicted first.
+    std::vector<Nogood> nogoods;
+    size_t nogoodHead = 0;
+    std::unordered_map<uint64_t, std::vector<int>> nogoodWatch; // literal key -> nogood ids
+
+    VariableOrdering variableOrdering = VariableOrdering::DomWdeg;
+    std::vector<int> varDegree;   // Variables sharing a section, candidate staff or candidate room
+    std::vector<int> varWeight;   // dom/wdeg failure weights, kept across the retries of one request
+    std::vector<int> varTieRank;  // Last tie-breaker: the static sort order, reshuffled on retries
+
+    // Unassigned variables bucketed by popcount(liveStarts); O(1) moves as domains change
+    std::vector<std::vector<int>> domainBuckets;
+    std::vector<int> bucketSlot;
+
+    std::string lastError = "";
+    int iterationCount = 0;
+    std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+    const std::atomic<bool>* cancelFlag = nullptr; // Cooperative stop request from portfolio siblings
+    SolveControl control;
+    int reportedIterations = 0;
+    int iterationLimit = MAX_ITERATIONS;
+    int fixedVariables = 0; // Seeded assignments outside the solver's variable list, counted in reported depth
+    mutable SolverCounters counters; // Mutable so the read-only checks can count themselves
+
+    // Weighted soft-constraint penalty of the board, kept by applyMove/undoMove while tracking
+    bool trackObjective = false;
+    long long objective = 0;
+};
+
+// Union of the given sections' occupancy. Four independent accumulators keep the loads in
+// flight together instead of chaining every OR on the previous one.
+template <class Mask>
+inline Mask sectionsOccupancy(const SolverState<Mask>& st, const std::vector<int>& sections) {
+    const int* idx = sections.data();
+    size_t n = sections.size(), i = 0;
+    Mask a = 0, b = 0, c = 0, d = 0;
+    for (; i + 4 <= n; i += 4) {
+        a |= st.sectionBusy[idx[i]];
+        b |= st.sectionBusy[idx[i + 1]];
+        c |= st.sectionBusy[idx[i + 2]];
+        d |= st.sectionBusy[idx[i + 3]];
+    }
+    for (; i < n; i++) a |= st.sectionBusy[idx[i]];
+    return a | b | c | d;
+}
+
+// Resumable walk over a variable's domain (openDomain/nextValue). Values are produced one at a
+// time and checked against the state when produced, so a node that succeeds on its first value
+// never enumerates the rest; each search depth keeps one cursor and reuses its buffers.
+template <class Mask>
+struct DomainCursor {
+    Mask starts = 0;               // Start slots not yet exhausted, lowest first
+    std::vector<int> staff, rooms; // Candidates left after symmetry breaking
+    size_t staffPos = 0, roomPos = 0;
+    CSPValue preferred = { -1, -1, -1 };
+    bool preferredPending = false;
+    int produced = 0;              // Values handed out since openDomain
+};
+
+// --- Portfolio ---
+
+// Fixed set of worker threads fed from a FIFO queue; shared by all requests of the server
+class WorkerPool {
+public:
+    explicit WorkerPool(int threads) {
+        for (int i = 0; i < std::max(1, threads); i++) {
+            workers.emplace_back([this]() {
+                while (true) {
+                    std::function<void()> task;
+                    {
+                        std::unique_lock<std::mutex> lock(queueMutex);
+                        queueReady.wait(lock, [this]() { return stopping || !tasks.empty(); });
+                        if (stopping && tasks.empty()) return;
+                        task = std::move(tasks.front());
+                        tasks.pop();
+                    }
+                    task();
+                }
+            });
+        }
+    }
+
+    ~WorkerPool() {
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            stopping = true;
+        }
+        queueReady.notify_all();
+        for (std::thread& worker : workers) worker.join();
+    }
+
+    template <typename F>
+    std::future<void> submit(F f) {
+        auto task = std::make_shared<std::packaged_task<void()>>(std::move(f));
+        std::future<void> done = task->get_future();
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            tasks.push([task]() { (*task)(); });
+        }
+        queueReady.notify_one();
+        return done;
+    }
+
+    int size() const { return workers.size(); }
+
+private:
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> tasks;
+    std::mutex queueMutex;
+    std::condition_variable queueReady;
+    bool stopping = false;
+};
+
+struct SolverStrategy {
+    std::string name;
+    VariableOrdering ordering;
+    unsigned seed; // 0 keeps the static tie-break order
+    SolverEngine engine = SolverEngine::Backtrack;
+};
+
+template <class Mask>
+struct SolveOutcome {
+    bool success = false;
+    SolverState<Mask> state; // Winning (or last failed) search state
+    std::string strategy;
+    int attempts = 0;
+    SolverCounters counters; // Summed over every attempt and portfolio member
+    int components = 1;      // Independent subproblems the variables were split into
+};
+
+// CNF encoding of placing a variable list (see encodeSat()). The start, staff and room choices
+// of a variable are consecutive Boolean variables from startVar, staffVar and roomVar on.
+struct SatEncoding {
+    CnfFormula formula;
+    std::vector<std::vector<int>> starts, staff, rooms; // Per variable: the slot, staff or room index of each choice
+    std::vector<int> startVar, staffVar, roomVar;       // roomVar is 0 when the variable needs no room
+    int unschedulable = -1; // A variable without any live start (nothing else is encoded then), or -1
+};
+
+// --- Solver API ---
+
+const ObjectiveWeights DEFAULT_WEIGHTS = { 3, 2, 1 };
+const long long DEFAULT_OPTIMIZE_MS = 5000;
+
+// Wall time of each phase of a request, in milliseconds
+struct PhaseTimings {
+    double queueWait = 0, parse = 0, validate = 0, identify = 0, solve = 0, optimize = 0, serialize = 0;
+};
+
+// Model building
+void parseInputData(ProblemModel& model, const json& inputData);
+// Reads "grid": { "days", "periodsPerDay" }; a count that is not a positive integer fails validation
+void parseGrid(WeekGrid& grid, const json& spec);
+// Same result as parseInputData() on the parsed body, without building its DOM. Top-level keys
+// other than the entity lists land in `options` (the grid is also applied to the model).
+// On malformed input, returns false with `error` naming the JSON path of the offending value.
+bool parseInputStream(const std::string& text, ProblemModel& model, json& options, std::string& error);
+void compileModel(ProblemModel& model);
+std::vector<std::string> validateInput(const ProblemModel& model);
+std::vector<std::string> analyzeFeasibility(const ProblemModel& model, const std::vector<CSPVariable>& variables);
+std::vector<CSPVariable> identifyVariables(const ProblemModel& model);
+void compileVariables(const ProblemModel& model, std::vector<CSPVariable>& variables);
+bool buildProblem(const json& inputData, ProblemModel& model, std::vector<CSPVariable>& variables, json& errResponse, PhaseTimings* timings = nullptr);
+bool compileProblem(ProblemModel& model, std::vector<CSPVariable>& variables, json& errResponse, PhaseTimings* timings = nullptr);
+void compileUnchecked(ProblemModel& model, std::vector<CSPVariable>& variables);
+bool checkProblem(const ProblemModel& model, const std::vector<CSPVariable>& variables, json& errResponse, PhaseTimings* timings = nullptr);
+
+// Mask widths. The solver functions below are templates over the mask type, compiled for
+// uint64_t, WideMask<2> and WideMask<4>; withSlotMask() calls f with a value of the narrowest
+// one that holds the grid, so a request runs the instantiation specialized for its week.
+template <class F>
+auto withSlotMask(const WeekGrid& grid, F&& f) {
+    if (grid.slots() <= 64) return f(uint64_t(0));
+    if (grid.slots() <= 128) return f(WideMask<2>());
+    return f(WideMask<4>());
+}
+
+// Board state and constraint checks
+template <class Mask> void resetSimulationState(SolverState<Mask>& st);
+template <class Mask> bool isInstructorAvailable(const SolverState<Mask>& st, int staffIdx, int startSlot, int duration);
+template <class Mask> bool isRoomAvailable(const SolverState<Mask>& st, int roomIdx, int startSlot, int duration);
+template <class Mask> bool isValidMove(const SolverState<Mask>& st, const CSPVariable& var, const CSPValue& val);
+template <class Mask> void applyMove(SolverState<Mask>& st, const CSPVariable& var, const CSPValue& val);
+template <class Mask> void undoMove(SolverState<Mask>& st, const CSPVariable& var, const CSPValue& val);
+template <class Mask> Mask computeLiveStarts(const SolverState<Mask>& st, const CSPVariable& var);
+template <class Mask> void openDomain(const SolverState<Mask>& st, const CSPVariable& var, Mask starts, DomainCursor<Mask>& cursor);
+template <class Mask> bool nextValue(const SolverState<Mask>& st, const CSPVariable& var, DomainCursor<Mask>& cursor, CSPValue& val);
+
+// Soft constraints
+template <class Mask> long long moveDelta(const SolverState<Mask>& st, const CSPVariable& var, const CSPValue& val);
+template <class Mask> ObjectiveTerms evaluateObjective(const SolverState<Mask>& st, const std::vector<CSPVariable>& variables);
+long long weightedObjective(const ObjectiveWeights& w, const ObjectiveTerms& terms);
+
+// Serialization
+enum class WireFormat { Json, Cbor, MsgPack };
+
+// Appends JSON text, CBOR or MessagePack straight to a byte string, without building a DOM.
+// Containers are given their element count up front, as CBOR and MessagePack headers carry it.
+class WireWriter {
+public:
+    explicit WireWriter(WireFormat format) : format(format) {}
+
+    void beginObject(size_t size);
+    void beginArray(size_t size);
+    void end();
+    void key(const std::string& name);
+    void text(const std::string& value);
+    void integer(long long value);
+    void boolean(bool value);
+    void value(const json& value); // Any DOM value, for the small parts of a response
+
+    std::string& bytes() { return out; }
+
+private:
+    WireFormat format;
+    std::string out;
+    std::vector<char> closers; // JSON: ']' or '}' of each open container
+    bool firstElement = true;  // JSON: no comma before the next element
+    bool afterKey = false;     // JSON: the next value belongs to the key just written
+
+    void separator();
+    void header(int major, uint64_t size); // CBOR initial byte plus argument
+    void bigEndian(uint64_t value, int bytes);
+};
+
+// Writes {"success": true, "slotsMax", "grid", "sections": [...]} plus every member of `extra`
+template <class Mask> void writeTimetable(WireWriter& writer, const SolverState<Mask>& st, const json& extra);
+std::string encodeJson(const json& value, WireFormat format);
+
+// Statistics
+json countersToJson(const SolverCounters& counters);
+double elapsedMs(std::chrono::steady_clock::time_point since);
+
+// Search
+VariableOrdering parseVariableOrdering(const std::string& name);
+SolverEngine parseSolverEngine(const std::string& name);
+std::string solverEngineName(SolverEngine engine);
+template <class Mask> bool solveIterative(SolverState<Mask>& st, const std::vector<CSPVariable>& variables);
+template <class Mask> bool completeAssignment(SolverState<Mask>& st, const std::vector<CSPVariable>& variables, const std::vector<CSPValue>& values, const std::vector<char>& fixed, int iterationBudget);
+template <class Mask> bool solveLocalSearch(SolverState<Mask>& st, const std::vector<CSPVariable>& variables, unsigned seed);
+template <class Mask> SatEncoding encodeSat(const SolverState<Mask>& st, const std::vector<CSPVariable>& variables);
+template <class Mask> bool solveSat(SolverState<Mask>& st, const std::vector<CSPVariable>& variables, unsigned seed);
+template <class Mask> int improveTimetable(SolverState<Mask>& st, const std::vector<CSPVariable>& variables, std::chrono::steady_clock::time_point deadline, unsigned seed);
+SolverStrategy portfolioStrategy(int i, VariableOrdering requested, unsigned baseSeed, SolverEngine engine);
+template <class Mask> bool runStrategy(SolverState<Mask>& st, const ProblemModel& model, const std::vector<CSPVariable>& variables, const SolverStrategy& strategy, const std::atomic<bool>* cancelFlag, const SolveControl& control);
+template <class Mask> SolveOutcome<Mask> solveWithRetries(const ProblemModel& model, const std::vector<CSPVariable>& variables, VariableOrdering ordering, SolverEngine engine, const SolveControl& control);
+template <class Mask> SolveOutcome<Mask> solvePortfolio(WorkerPool& pool, const ProblemModel& model, const std::vector<CSPVariable>& variables, VariableOrdering ordering, SolverEngine engine, int threads, const SolveControl& control);
+std::vector<std::vector<int>> independentComponents(const ProblemModel& model, const std::vector<CSPVariable>& variables, bool throughRooms);
+bool partitionRooms(const ProblemModel& model, const std::vector<CSPVariable>& variables, const std::vector<std::vector<int>>& components, std::vector<std::vector<CSPVariable>>& subproblems);
+template <class Mask> SolveOutcome<Mask> solveDecomposed(WorkerPool& pool, const ProblemModel& model, const std::vector<CSPVariable>& variables, VariableOrdering ordering, SolverEngine engine, int threads, const SolveControl& control);
+
+// Warm start
+void applyInputDelta(json& data, const json& delta);
+// Whether the delta only holds changes applyInputDelta() knows, each with values of the right
+// types; otherwise `error` names the first offending member
+bool checkInputDelta(const json& delta, std::string& error);
+
+// What-if variants of one compiled problem. A variant shares the base's model and variable list,
+// and copies either one only when its delta changes it.
+struct ProblemVariant {
+    std::shared_ptr<const ProblemModel> model;
+    std::shared_ptr<const std::vector<CSPVariable>> variables;
+};
+// Whether applyVariantDelta() can apply the delta; section changes renumber the variables and
+// need a full rebuild with applyInputDelta()
+bool isVariantDelta(const json& delta);
+// Applies staffUnavailable, removeStaff, addRooms and removeRooms to a compiled base without
+// reparsing it. Entity indices stay those of the base; the result still needs checkProblem().
+ProblemVariant applyVariantDelta(const ProblemVariant& base, const json& delta);
+std::vector<CSPValue> previousAssignment(const ProblemModel& model, const std::vector<CSPVariable>& variables, const json& previous);
+template <class Mask> bool resolveFromPrevious(SolverState<Mask>& st, const std::vector<CSPVariable>& variables, const std::vector<CSPValue>& previous, int& freedCount, int& rounds);
@@ -0,0 +1,146 @@
+// Engine check run by ctest: solves generated instances with the "sat" and "auto" engines and
+// verifies every timetable independently of the solver's own bookkeeping, then makes sure both
+// engines prove a small over-subscribed problem infeasible. Exits non-zero if any check fails.
+//
+//   engine_check [--seed N]
+
+#include "../bench/instance_generator.h"
+#include "solver.h"
+#include <cstdlib>
+#include <iostream>
+#include <set>
+
+using namespace std;
+
+int failures = 0;
+
+void fail(const string& name, const string& message) {
+    cerr << "FAIL " << name << ": " << message << endl;
+    failures++;
+}
+
+// Checks the assignment against the parsed model only: every class placed within one day, with a
+// qualified and available staff member and an eligible room, and no section, staff member or
+// room in two classes at once. Returns the first problem found, empty if there is none.
+string checkTimetable(const ProblemModel& model, const vector<CSPVariable>& variables, const vector<CSPValue>& values) {
+    map<string, set<int>> unavailable;
+    for (auto& inst : model.instructors) unavailable[inst.instructorID].insert(inst.unavailableTimeSlots.begin(), inst.unavailableTimeSlots.end());
+    for (auto& ta : model.tas) unavailable[ta.taID].insert(ta.unavailableTimeSlots.begin(), ta.unavailableTimeSlots.end());
+
+    set<pair<string, int>> sectionBusy, staffBusy, roomBusy;
+    for (size_t v = 0; v < variables.size(); v++) {
+        const CSPVariable& var = variables[v];
+        const CSPValue& val = values[v];
+        string name = "class " + to_string(var.id) + " (" + var.courseID + ")";
+        if (!model.grid.fits(val.startSlot, var.duration)) return name + " does not fit the week at slot " + to_string(val.startSlot);
+        if (find(var.candidateStaff.begin(), var.candidateStaff.end(), val.staffIdx) == var.candidateStaff.end()) return name + " has unqualified staff";
+        if (find(var.candidateRooms.begin(), var.candidateRooms.end(), val.roomIdx) == var.candidateRooms.end()) return name + " has an ineligible room";
+
+        const string& staffID = model.staffIDs[val.staffIdx];
+        for (int slot = val.startSlot; slot < val.startSlot + var.duration; slot++) {
+            if (unavailable[staffID].count(slot)) return name + " uses " + staffID + " while unavailable";
+            if (!staffBusy.insert({ staffID, slot }).second) return name + " double-books " + staffID + " at slot " + to_string(slot);
+            if (val.roomIdx >= 0 && !roomBusy.insert({ model.rooms[val.roomIdx].roomID, slot }).second) {
+                return name + " double-books room " + model.rooms[val.roomIdx].roomID + " at slot " + to_string(slot);
+            }
+            for (int secIdx : var.targetSectionIndices) {
+                if (!sectionBusy.insert({ model.sections[secIdx].sectionID, slot }).second) {
+                    return name + " double-books section " + model.sections[secIdx].sectionID + " at slot " + to_string(slot);
+                }
+            }
+        }
+    }
+    return "";
+}
+
+struct EngineRun {
+    bool solved = false, proved = false;
+    bool usedSat = false; // The SAT backend ran, on its own or after the auto handoff
+    vector<CSPValue> values;
+};
+
+template <class Mask>
+EngineRun solveWith(const ProblemModel& model, const vector<CSPVariable>& variables, SolverEngine engine, unsigned seed) {
+    SolverState<Mask> st;
+    SolverStrategy strategy = portfolioStrategy(0, VariableOrdering::DomWdeg, seed, engine);
+    EngineRun run;
+    run.solved = runStrategy(st, model, variables, strategy, nullptr, SolveControl());
+    run.proved = st.provedInfeasible;
+    run.usedSat = st.counters.satVariables > 0;
+    run.values = st.assignedValue;
+    return run;
+}
+
+// `handoff`: the instance stalls the backtracker, so "auto" must finish it with the SAT backend
+void checkInstance(const InstanceParams& params, SolverEngine engine, bool handoff) {
+    string name = string(solverEngineName(engine)) + " groups=" + to_string(params.groupsPerYear) + " scarcity=" + to_string(params.roomScarcity)
+        + " grid=" + to_string(params.days) + "x" + to_string(params.periodsPerDay);
+    ProblemModel model;
+    vector<CSPVariable> variables;
+    json error;
+    if (!buildProblem(generateInstance(params), model, variables, error)) return fail(name, "instance rejected: " + error.dump());
+
+    withSlotMask(model.grid, [&](auto widthTag) {
+        typedef decltype(widthTag) Mask;
+        EngineRun run = solveWith<Mask>(model, variables, engine, params.seed);
+        if (!run.solved) return fail(name, run.proved ? "proved infeasible" : "not solved");
+        if (handoff && !run.usedSat) return fail(name, "solved without reaching the SAT backend; the instance no longer covers the handoff");
+        string problem = checkTimetable(model, variables, run.values);
+        if (!problem.empty()) return fail(name, problem);
+        cerr << "ok   " << name << " (" << variables.size() << " classes" << (run.usedSat ? ", SAT" : "") << ")" << endl;
+    });
+}
+
+// One section with two one-period tutorials on a one-slot week. Compiled without the pre-solve
+// capacity checks, which would reject it before any engine ran.
+void checkInfeasible(SolverEngine engine) {
+    string name = string(solverEngineName(engine)) + " two classes on a one-slot week";
+    json input = {
+        { "grid", { { "days", 1 }, { "periodsPerDay", 1 } } },
+        { "courses", { { { "courseID", "T1" }, { "courseName", "Tutorial 1" }, { "type", "tut" }, { "duration", 1 } },
+                       { { "courseID", "T2" }, { "courseName", "Tutorial 2" }, { "type", "tut" }, { "duration", 1 } } } },
+        { "tas", { { { "taID", "TA1" }, { "name", "TA 1" }, { "qualifiedCourses", { "T1", "T2" } } } } },
+        { "rooms", { { { "roomID", "R1" }, { "type", "tut" }, { "capacity", 30 } } } },
+        { "sections", { { { "sectionID", "S1" }, { "groupID", "G1" }, { "year", 1 }, { "studentCount", 30 }, { "assignedCourses", { "T1", "T2" } } } } },
+    };
+    ProblemModel model;
+    vector<CSPVariable> variables;
+    parseInputData(model, input);
+    compileUnchecked(model, variables);
+    if (variables.size() != 2) return fail(name, "expected 2 classes, got " + to_string(variables.size()));
+
+    EngineRun run = solveWith<uint64_t>(model, variables, engine, 0);
+    if (run.solved) return fail(name, "reported a timetable");
+    if (!run.proved) return fail(name, "gave up without proving infeasibility");
+    cerr << "ok   " << name << " (proved infeasible)" << endl;
+}
+
+int main(int argc, char** argv) {
+    unsigned seed = 1;
+    for (int i = 1; i + 1 < argc; i++) {
+        if (string(argv[i]) == "--seed") seed = strtoul(argv[++i], nullptr, 10);
+    }
+
+    // Narrow and wide masks, loose and tight rooms, and with seed 1 one instance that stalls the
+    // backtracker past AUTO_STALL_ITERATIONS
+    const struct { int groups; double scarcity, qualification; int days, periods; bool handoff; } shapes[] = {
+        { 1, 0.5, 0.3, 5, 8, false }, { 2, 0.9, 0.3, 5, 8, false }, { 3, 0.7, 0.3, 5, 8, false },
+        { 2, 0.7, 0.3, 6, 10, false }, { 2, 0.7, 0.3, 6, 24, false }, { 3, 0.9, 0.15, 5, 8, true },
+    };
+    for (SolverEngine engine : { SolverEngine::Sat, SolverEngine::Auto }) {
+        for (auto& shape : shapes) {
+            InstanceParams params;
+            params.groupsPerYear = shape.groups;
+            params.roomScarcity = shape.scarcity;
+            params.qualificationDensity = shape.qualification;
+            params.days = shape.days;
+            params.periodsPerDay = shape.periods;
+            params.seed = seed;
+            checkInstance(params, engine, shape.handoff && engine == SolverEngine::Auto && seed == 1);
+        }
+        checkInfeasible(engine);
+    }
+
+    if (failures) cerr << failures << " check(s) failed" << endl;
+    return failures ? 1 : 0;
+}
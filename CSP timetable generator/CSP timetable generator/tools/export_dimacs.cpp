@@ -0,0 +1,91 @@
+// DIMACS export: encodes a schedule request the way the "sat" engine does and writes the CNF, so
+// the instance can be run through other SAT solvers and benchmarked offline.
+//
+//   export_dimacs REQUEST.json [--out FILE]
+//
+// The comment lines map the Boolean variables back to the timetable: one line per class gives
+// its course, sections and the first variable of its start, staff and room choices, followed by
+// the slots, staff IDs and room IDs those consecutive variables stand for.
+
+#include "solver.h"
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+using namespace std;
+
+string joined(const vector<string>& items) {
+    string out;
+    for (size_t i = 0; i < items.size(); i++) out += (i ? "," : "") + items[i];
+    return out;
+}
+
+int main(int argc, char** argv) {
+    string inputPath, outputPath;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg.rfind("--", 0) != 0) inputPath = arg;
+        else if (i + 1 >= argc) break;
+        else if (arg == "--out") outputPath = argv[++i];
+    }
+    if (inputPath.empty()) {
+        cerr << "Usage: export_dimacs REQUEST.json [--out FILE]" << endl;
+        return 2;
+    }
+
+    ifstream in(inputPath);
+    json inputData = json::parse(in, nullptr, false);
+    if (!in || inputData.is_discarded() || !inputData.is_object()) {
+        cerr << "Cannot read " << inputPath << endl;
+        return 1;
+    }
+    ProblemModel model;
+    vector<CSPVariable> variables;
+    json errResponse;
+    if (!buildProblem(inputData, model, variables, errResponse)) {
+        cerr << errResponse.dump(2) << endl;
+        return 1;
+    }
+
+    return withSlotMask(model.grid, [&](auto widthTag) {
+        typedef decltype(widthTag) Mask;
+        SolverState<Mask> st;
+        st.model = &model;
+        resetSimulationState(st);
+        SatEncoding enc = encodeSat(st, variables);
+        if (enc.unschedulable >= 0) {
+            cerr << "Unable to schedule " << model.getCourse.at(variables[enc.unschedulable].courseID).courseName << " (no feasible slot)" << endl;
+            return 1;
+        }
+
+        ostringstream comment;
+        comment << "Timetable encoding of " << inputPath << ": " << variables.size() << " classes, "
+            << model.grid.days << " days x " << model.grid.periodsPerDay << " periods\n";
+        comment << "class <id> <course> <sections> start <var> <slots> staff <var> <staffIDs> room <var> <roomIDs>\n";
+        for (size_t v = 0; v < variables.size(); v++) {
+            const CSPVariable& var = variables[v];
+            vector<string> sections, slots, staff, rooms;
+            for (int secIdx : var.targetSectionIndices) sections.push_back(model.sections[secIdx].sectionID);
+            for (int slot : enc.starts[v]) slots.push_back(to_string(slot));
+            for (int staffIdx : enc.staff[v]) staff.push_back(model.staffIDs[staffIdx]);
+            for (int roomIdx : enc.rooms[v]) rooms.push_back(model.rooms[roomIdx].roomID);
+            comment << "class " << var.id << ' ' << var.courseID << ' ' << joined(sections)
+                << " start " << enc.startVar[v] << ' ' << joined(slots)
+                << " staff " << enc.staffVar[v] << ' ' << joined(staff)
+                << " room " << enc.roomVar[v] << ' ' << (rooms.empty() ? "-" : joined(rooms)) << '\n';
+        }
+
+        if (outputPath.empty()) {
+            writeDimacs(cout, enc.formula, comment.str());
+            return 0;
+        }
+        ofstream out(outputPath);
+        writeDimacs(out, enc.formula, comment.str());
+        if (!out) {
+            cerr << "Cannot write " << outputPath << endl;
+            return 1;
+        }
+        cerr << enc.formula.variables << " variables, " << enc.formula.clauses << " clauses written to " << outputPath << endl;
+        return 0;
+    });
+}
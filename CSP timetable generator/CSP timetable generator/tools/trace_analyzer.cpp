@@ -0,0 +1,318 @@
+// Search trace analyzer: reads the ring file the server writes with --trace and reports where
+// solveIterative() spent its effort. Prints one JSON document:
+//   runs       one entry per solveIterative() run: request, outcome, duration, decisions, depth
+//   depths     per depth: assignments, rejections by reason, backjumps leaving and landing there
+//   variables  the variables that failed most: failures, times blamed by a backjump, rejections
+//   hotspots   thrashing: the (blamed, failing) variable pairs the search keeps jumping between
+//   jumps      histogram of backjump distances
+//
+//   trace_analyzer TRACE [--input REQUEST.json] [--request N] [--run N] [--top N] [--out FILE]
+//
+// With --input, variables are named after their course and sections, rebuilt from the request
+// body that was traced. Runs from before a ring wrap-around are only partly kept.
+
+#include "solver.h"
+#include "trace.h"
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+using namespace std;
+
+struct AnalyzerConfig {
+    string tracePath;
+    string inputPath;    // Request body, for variable names
+    long long request = -1; // Only runs of this request number (diagnostics.traceRequest)
+    long long run = -1;     // Only this run
+    int top = 20;           // Entries in the variable and hotspot lists
+    string outputPath;      // JSON goes to stdout when empty
+};
+
+AnalyzerConfig parseAnalyzerConfig(int argc, char** argv) {
+    AnalyzerConfig config;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg.rfind("--", 0) != 0) config.tracePath = arg;
+        else if (i + 1 >= argc) break;
+        else if (arg == "--input") config.inputPath = argv[++i];
+        else if (arg == "--request") config.request = atoll(argv[++i]);
+        else if (arg == "--run") config.run = atoll(argv[++i]);
+        else if (arg == "--top") config.top = max(1, atoi(argv[++i]));
+        else if (arg == "--out") config.outputPath = argv[++i];
+    }
+    return config;
+}
+
+struct RunSummary {
+    long long request = -1; // Unknown when the Begin record was overwritten
+    int variables = -1;
+    string outcome = "unfinished";
+    uint32_t firstUs = 0, lastUs = 0;
+    long long assignments = 0, nogoodRejections = 0, forwardRejections = 0, backjumps = 0;
+    int maxDepth = 0;
+    vector<int> order; // order[depth] = variable last assigned there
+};
+
+struct DepthStats {
+    long long assignments = 0, nogoodRejections = 0, forwardRejections = 0, backjumpsFrom = 0, backjumpsTo = 0;
+};
+
+struct VariableStats {
+    long long assignments = 0, nogoodRejections = 0, forwardRejections = 0;
+    long long failures = 0; // Ran out of values
+    long long blamed = 0;   // Was the assignment a backjump returned to
+    long long failureDepthSum = 0;
+};
+
+struct Hotspot {
+    long long count = 0, distanceSum = 0;
+};
+
+string outcomeName(int outcome) {
+    switch ((TraceOutcome)outcome) {
+    case TraceOutcome::Solved: return "solved";
+    case TraceOutcome::Infeasible: return "infeasible";
+    case TraceOutcome::Timeout: return "timeout";
+    case TraceOutcome::IterationLimit: return "iterationLimit";
+    case TraceOutcome::Cancelled: return "cancelled";
+    default: return "unknown";
+    }
+}
+
+// "Course (S1, S2)" for every variable of the request, by CSPVariable::id
+unordered_map<int, string> variableNames(const string& inputPath, string& error) {
+    unordered_map<int, string> names;
+    ifstream in(inputPath);
+    json inputData = json::parse(in, nullptr, false);
+    if (!in || inputData.is_discarded() || !inputData.is_object()) {
+        error = "Cannot read " + inputPath;
+        return names;
+    }
+    ProblemModel model;
+    parseInputData(model, inputData);
+    compileModel(model);
+    for (const CSPVariable& var : identifyVariables(model)) {
+        string name = model.getCourse.at(var.courseID).courseName + " (";
+        for (size_t i = 0; i < var.targetSectionIndices.size(); i++) {
+            name += (i ? ", " : "") + model.sections[var.targetSectionIndices[i]].sectionID;
+        }
+        names[var.id] = name + ")";
+    }
+    return names;
+}
+
+int main(int argc, char** argv) {
+    AnalyzerConfig config = parseAnalyzerConfig(argc, argv);
+    if (config.tracePath.empty()) {
+        cerr << "Usage: trace_analyzer TRACE [--input REQUEST.json] [--request N] [--run N] [--top N] [--out FILE]" << endl;
+        return 2;
+    }
+
+    ifstream in(config.tracePath, ios::binary);
+    TraceHeader header;
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)) || memcmp(header.magic, TRACE_MAGIC, sizeof(TRACE_MAGIC)) != 0) {
+        cerr << config.tracePath << " is not a search trace" << endl;
+        return 1;
+    }
+    if (header.version != TRACE_VERSION || header.recordSize != sizeof(TraceRecord) || header.capacity == 0) {
+        cerr << config.tracePath << ": unsupported trace version " << header.version << endl;
+        return 1;
+    }
+    uint64_t written = header.written.load();
+    uint64_t kept = min<uint64_t>(written, header.capacity);
+    uint64_t oldest = written > header.capacity ? written % header.capacity : 0;
+    vector<TraceRecord> records(header.capacity);
+    if (!in.read(reinterpret_cast<char*>(records.data()), header.capacity * sizeof(TraceRecord))) {
+        cerr << config.tracePath << " is truncated" << endl;
+        return 1;
+    }
+
+    unordered_map<int, string> names;
+    if (!config.inputPath.empty()) {
+        string error;
+        names = variableNames(config.inputPath, error);
+        if (!error.empty()) cerr << error << ", reporting variable ids only" << endl;
+    }
+
+    map<uint32_t, RunSummary> runs;
+    vector<DepthStats> depths;
+    unordered_map<int, VariableStats> variables;
+    map<pair<int, int>, Hotspot> hotspots; // (blamed, failing)
+    map<int, long long> jumpDistances;
+    long long analyzed = 0;
+
+    for (uint64_t i = 0; i < kept; i++) {
+        const TraceRecord& r = records[(oldest + i) % header.capacity];
+        if (config.run >= 0 && r.run != config.run) continue;
+        TraceEvent event = (TraceEvent)r.event;
+        auto found = runs.find(r.run);
+        if (found == runs.end()) {
+            // The first record kept of a run; filtering by request needs its Begin record
+            if (config.request >= 0 && event != TraceEvent::Begin) continue;
+            found = runs.emplace(r.run, RunSummary()).first;
+            found->second.firstUs = r.timeUs;
+        }
+        RunSummary& run = found->second;
+        if (event == TraceEvent::Begin) {
+            if (config.request >= 0 && r.value != config.request) {
+                runs.erase(found);
+                continue;
+            }
+            run.variables = r.variable;
+            run.request = r.value;
+            continue;
+        }
+        run.lastUs = r.timeUs;
+        analyzed++;
+        if (event == TraceEvent::End) {
+            run.outcome = outcomeName(r.value);
+            continue;
+        }
+
+        int depth = r.depth;
+        if (depths.size() <= (size_t)depth) depths.resize(depth + 1);
+        VariableStats& var = variables[r.variable];
+        switch (event) {
+        case TraceEvent::Assign:
+            if (run.order.size() <= (size_t)depth) run.order.resize(depth + 1, -1);
+            run.order[depth] = r.variable;
+            run.assignments++;
+            run.maxDepth = max(run.maxDepth, depth + 1);
+            depths[depth].assignments++;
+            var.assignments++;
+            break;
+        case TraceEvent::RejectNogood:
+            run.nogoodRejections++;
+            depths[depth].nogoodRejections++;
+            var.nogoodRejections++;
+            break;
+        case TraceEvent::RejectForward:
+            run.forwardRejections++;
+            depths[depth].forwardRejections++;
+            var.forwardRejections++;
+            break;
+        case TraceEvent::Backjump: {
+            run.backjumps++;
+            depths[depth].backjumpsFrom++;
+            var.failures++;
+            var.failureDepthSum += depth;
+            int target = r.value;
+            if (target < 0) break; // Proved infeasible; the End record follows
+            depths[target].backjumpsTo++;
+            jumpDistances[depth - target]++;
+            int blamed = (size_t)target < run.order.size() ? run.order[target] : -1;
+            if (blamed >= 0) variables[blamed].blamed++;
+            Hotspot& hotspot = hotspots[{ blamed, r.variable }];
+            hotspot.count++;
+            hotspot.distanceSum += depth - target;
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    auto describe = [&](int id) {
+        json entry = { { "id", id } };
+        auto name = names.find(id);
+        if (name != names.end()) entry["name"] = name->second;
+        return entry;
+    };
+
+    json runList = json::array();
+    for (auto& entry : runs) {
+        const RunSummary& run = entry.second;
+        runList.push_back({
+            { "run", entry.first },
+            { "request", run.request >= 0 ? json(run.request) : json(nullptr) },
+            { "variables", run.variables >= 0 ? json(run.variables) : json(nullptr) },
+            { "outcome", run.outcome },
+            { "durationMs", (uint32_t)(run.lastUs - run.firstUs) / 1000.0 },
+            { "assignments", run.assignments },
+            { "nogoodRejections", run.nogoodRejections },
+            { "forwardRejections", run.forwardRejections },
+            { "backjumps", run.backjumps },
+            { "maxDepth", run.maxDepth },
+        });
+    }
+
+    json depthList = json::array();
+    for (size_t d = 0; d < depths.size(); d++) {
+        const DepthStats& s = depths[d];
+        depthList.push_back({
+            { "depth", d },
+            { "assignments", s.assignments },
+            { "nogoodRejections", s.nogoodRejections },
+            { "forwardRejections", s.forwardRejections },
+            { "backjumpsFrom", s.backjumpsFrom },
+            { "backjumpsTo", s.backjumpsTo },
+        });
+    }
+
+    vector<pair<int, VariableStats>> byFailures(variables.begin(), variables.end());
+    sort(byFailures.begin(), byFailures.end(), [](const pair<int, VariableStats>& a, const pair<int, VariableStats>& b) {
+        return a.second.failures != b.second.failures ? a.second.failures > b.second.failures : a.first < b.first;
+    });
+    if (byFailures.size() > (size_t)config.top) byFailures.resize(config.top);
+    json variableList = json::array();
+    for (auto& entry : byFailures) {
+        const VariableStats& s = entry.second;
+        json item = describe(entry.first);
+        item["failures"] = s.failures;
+        item["blamed"] = s.blamed;
+        item["assignments"] = s.assignments;
+        item["nogoodRejections"] = s.nogoodRejections;
+        item["forwardRejections"] = s.forwardRejections;
+        item["meanFailureDepth"] = s.failures ? (double)s.failureDepthSum / s.failures : 0.0;
+        variableList.push_back(item);
+    }
+
+    vector<pair<pair<int, int>, Hotspot>> byCount(hotspots.begin(), hotspots.end());
+    sort(byCount.begin(), byCount.end(), [](const pair<pair<int, int>, Hotspot>& a, const pair<pair<int, int>, Hotspot>& b) {
+        return a.second.count != b.second.count ? a.second.count > b.second.count : a.first < b.first;
+    });
+    if (byCount.size() > (size_t)config.top) byCount.resize(config.top);
+    json hotspotList = json::array();
+    for (auto& entry : byCount) {
+        hotspotList.push_back({
+            { "blamed", entry.first.first >= 0 ? describe(entry.first.first) : json(nullptr) },
+            { "failing", describe(entry.first.second) },
+            { "backjumps", entry.second.count },
+            { "meanDistance", (double)entry.second.distanceSum / entry.second.count },
+        });
+    }
+
+    json jumpList = json::array();
+    for (auto& entry : jumpDistances) jumpList.push_back({ { "distance", entry.first }, { "count", entry.second } });
+
+    json report;
+    report["trace"] = {
+        { "path", config.tracePath },
+        { "capacity", header.capacity },
+        { "written", written },
+        { "kept", kept },
+        { "wrapped", written > header.capacity },
+        { "createdUnixUs", header.createdUnixUs },
+        { "requests", header.requests.load() },
+    };
+    report["analyzedRecords"] = analyzed;
+    report["runs"] = runList;
+    report["depths"] = depthList;
+    report["variables"] = variableList;
+    report["hotspots"] = hotspotList;
+    report["jumps"] = jumpList;
+
+    if (config.outputPath.empty()) {
+        cout << report.dump(2) << endl;
+    }
+    else {
+        ofstream out(config.outputPath);
+        out << report.dump(2) << endl;
+        if (!out) {
+            cerr << "Cannot write " << config.outputPath << endl;
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,85 @@
+﻿#include "trace.h"
+#include <cstring>
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+bool SearchTrace::open(const string& path, uint64_t capacity, string& error) {
+    close();
+    uint64_t rounded = 1;
+    while (rounded < capacity) rounded <<= 1;
+    size_t bytes = sizeof(TraceHeader) + rounded * sizeof(TraceRecord);
+    void* mapped = nullptr;
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        error = "Cannot create " + path + " (error " + to_string(GetLastError()) + ")";
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE, (DWORD)((uint64_t)bytes >> 32), (DWORD)(bytes & 0xFFFFFFFF), nullptr);
+    if (mapping) mapped = MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, bytes);
+    if (!mapped) {
+        error = "Cannot map " + path + " (error " + to_string(GetLastError()) + ")";
+        if (mapping) CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+    fileHandle = file;
+    mappingHandle = mapping;
+#else
+    int file = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (file < 0) {
+        error = "Cannot create " + path + ": " + strerror(errno);
+        return false;
+    }
+    if (ftruncate(file, (off_t)bytes) != 0 || (mapped = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0)) == MAP_FAILED) {
+        error = "Cannot map " + path + ": " + strerror(errno);
+        ::close(file);
+        return false;
+    }
+    fd = file;
+#endif
+
+    // The file starts out zeroed, so the counters are already valid atomics
+    header = static_cast<TraceHeader*>(mapped);
+    records = reinterpret_cast<TraceRecord*>(header + 1);
+    memcpy(header->magic, TRACE_MAGIC, sizeof(TRACE_MAGIC));
+    header->version = TRACE_VERSION;
+    header->recordSize = sizeof(TraceRecord);
+    header->capacity = rounded;
+    header->createdUnixUs = chrono::duration_cast<chrono::microseconds>(chrono::system_clock::now().time_since_epoch()).count();
+    slotMask = rounded - 1;
+    mappedBytes = bytes;
+    created = chrono::steady_clock::now();
+    return true;
+}
+
+void SearchTrace::close() {
+    if (!header) return;
+#ifdef _WIN32
+    UnmapViewOfFile(header);
+    CloseHandle(mappingHandle);
+    CloseHandle(fileHandle);
+    fileHandle = mappingHandle = nullptr;
+#else
+    munmap(header, mappedBytes);
+    ::close(fd);
+    fd = -1;
+#endif
+    header = nullptr;
+    records = nullptr;
+}
@@ -0,0 +1,97 @@
+﻿#pragma once
+
+// Search trace: fixed-size binary records of the decisions solveIterative() makes, appended to a
+// ring file mapped into memory. The server writes one when started with --trace FILE, and
+// tools/trace_analyzer turns it into hotspots, per-variable backtrack counts and depth histograms.
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+enum class TraceEvent : uint8_t {
+    Begin = 1,     // A solveIterative() run starts: variable = variable count, value = request number
+    Assign,        // Value `value` of the variable's domain is placed at `depth`
+    RejectNogood,  // ... is skipped because it completes a recorded nogood
+    RejectForward, // ... is undone because forward checking emptied another domain
+    Backjump,      // The variable ran out of values at `depth`: value = the depth jumped back to
+    End,           // The run stops: value = TraceOutcome
+};
+
+enum class TraceOutcome : int32_t { Solved, Infeasible, Timeout, IterationLimit, Cancelled };
+
+// One decision. The layout is the file format, so fields only ever get appended.
+struct TraceRecord {
+    uint32_t timeUs;  // Since the file was created; wraps after 71 minutes
+    uint32_t run;     // The solveIterative() call, numbered from 1 per file
+    int32_t variable; // CSPVariable::id
+    int32_t value;
+    uint16_t depth;
+    uint8_t event;    // TraceEvent
+    uint8_t reserved;
+};
+static_assert(sizeof(TraceRecord) == 20, "trace records are 20 bytes on disk");
+
+const char TRACE_MAGIC[8] = { 'C', 'S', 'P', 'T', 'R', 'A', 'C', 'E' };
+const uint32_t TRACE_VERSION = 1;
+
+// First 64 bytes of the file, followed by `capacity` records. Once the ring is full, record
+// `written % capacity` is the oldest one still kept.
+struct TraceHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t recordSize;
+    uint64_t capacity;             // A power of two
+    std::atomic<uint64_t> written; // Records ever appended
+    std::atomic<uint32_t> runs;    // Run numbers handed out
+    std::atomic<uint32_t> requests;
+    int64_t createdUnixUs;
+    uint8_t reserved[16];
+};
+static_assert(sizeof(TraceHeader) == 64, "the trace header is 64 bytes on disk");
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "trace counters live in a shared mapping");
+
+// Writer side of a trace file. Any number of solves append at once: a record costs one atomic
+// increment to claim its slot and a 20-byte store into the mapping; the OS writes pages back.
+class SearchTrace {
+public:
+    SearchTrace() = default;
+    ~SearchTrace() { close(); }
+    SearchTrace(const SearchTrace&) = delete;
+    SearchTrace& operator=(const SearchTrace&) = delete;
+
+    // Creates or truncates `path` with room for `capacity` records, rounded up to a power of two.
+    // Returns false with `error` set when the file cannot be created or mapped.
+    bool open(const std::string& path, uint64_t capacity, std::string& error);
+    void close();
+    bool isOpen() const { return header != nullptr; }
+
+    // Numbers a request, so the runs of one request can be told apart in the analyzer
+    uint32_t beginRequest() { return header->requests.fetch_add(1, std::memory_order_relaxed) + 1; }
+    uint32_t beginRun() { return header->runs.fetch_add(1, std::memory_order_relaxed) + 1; }
+
+    void record(uint32_t run, std::chrono::steady_clock::time_point now, TraceEvent event, int depth, int variable, int value) {
+        uint64_t slot = header->written.fetch_add(1, std::memory_order_relaxed) & slotMask;
+        TraceRecord& r = records[slot];
+        r.timeUs = (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(now - created).count();
+        r.run = run;
+        r.variable = variable;
+        r.value = value;
+        r.depth = (uint16_t)(depth < 0xFFFF ? depth : 0xFFFF);
+        r.event = (uint8_t)event;
+        r.reserved = 0;
+    }
+
+private:
+    TraceHeader* header = nullptr;
+    TraceRecord* records = nullptr;
+    uint64_t slotMask = 0;
+    size_t mappedBytes = 0;
+    std::chrono::steady_clock::time_point created;
+#ifdef _WIN32
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+#else
+    int fd = -1;
+#endif
+};
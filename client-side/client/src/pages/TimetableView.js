@@ -13,13 +13,18 @@ const TimetableView = () => {
   
   const timetableID = localStorage.getItem('selectedTimetableID');
   const backendDataURL = `http://localhost:5000/api/data/${timetableID}`;
-  const schedulerAPI = "http://127.0.0.1:8080/api/schedule";
+  const schedulerAPI = "http://127.0.0.1:8080/api/schedule/jobs";
+  const POLL_INTERVAL = 1000;
+  const JOB_TIMEOUT = 5 * 60 * 1000;
+  const unmountedRef = useRef(false);
+  const activeJobRef = useRef(null);
   
   const CACHE_KEY = `timetable_cache_${timetableID}`;
   const CACHE_TIMESTAMP_KEY = `timetable_cache_timestamp_${timetableID}`;
   const CACHE_DURATION = 30 * 60 * 1000;
 
   useEffect(() => {
+    unmountedRef.current = false;
     const loadData = async () => {
       const cacheLoaded = await loadCachedData();
       if (!cacheLoaded) {
@@ -27,6 +32,11 @@ const TimetableView = () => {
       }
     };
     loadData();
+    return () => {
+      // Stop polling and free the solver thread if the page is left mid-solve
+      unmountedRef.current = true;
+      cancelJob(activeJobRef.current);
+    };
   }, []);
 
   const loadCachedData = async () => {
@@ -81,19 +91,50 @@ const TimetableView = () => {
       const dataResponse = await axios.get(backendDataURL);
       if (!dataResponse.data) throw new Error("Invalid data response");
 
-      const scheduleResponse = await axios.post(schedulerAPI, dataResponse.data);
-    
-      if (scheduleResponse.data?.success) {
-        const newSections = scheduleResponse.data.sections || [];
+      const jobResponse = await axios.post(schedulerAPI, dataResponse.data);
+      const result = await waitForJob(jobResponse.data.jobID);
+
+      if (result?.success) {
+        const newSections = result.sections || [];
         setSections(newSections);
         saveToCache(newSections);
       } else {
-        setError("Schedule generation failed");
+        setError(result?.error || "Schedule generation failed");
       }
     } catch (err) {
-      setError(err.response?.data?.error || "Failed to generate schedule");
+      if (unmountedRef.current) return;
+      setError(err.response?.data?.error || err.message || "Failed to generate schedule");
+    } finally {
+      if (!unmountedRef.current) setLoading(false);
+    }
+  };
+
+  const cancelJob = (jobID) => {
+    if (jobID) axios.delete(`${schedulerAPI}/${jobID}`).catch(() => {});
+  };
+
+  // Polls a solver job until it finishes; returns the solver's response body. The job is
+  // cancelled if it outlives JOB_TIMEOUT or the page is unmounted while waiting.
+  const waitForJob = async (jobID) => {
+    activeJobRef.current = jobID;
+    const deadline = Date.now() + JOB_TIMEOUT;
+    try {
+      while (!unmountedRef.current) {
+        if (Date.now() >= deadline) {
+          cancelJob(jobID);
+          throw new Error("Schedule generation timed out");
+        }
+        await new Promise((resolve) => setTimeout(resolve, POLL_INTERVAL));
+        if (unmountedRef.current) break;
+        const statusResponse = await axios.get(`${schedulerAPI}/${jobID}`);
+        const job = statusResponse.data;
+        if (job.status === "succeeded" || job.status === "failed") return job.result;
+        if (job.status === "cancelled") throw new Error("Schedule generation was cancelled");
+      }
+      cancelJob(jobID);
+      throw new Error("Schedule generation was abandoned");
     } finally {
-      setLoading(false);
+      activeJobRef.current = null;
     }
   };
 